@@ -0,0 +1,120 @@
+#include <filesystem>
+
+/*
+ * admission control for the process generator
+ *
+ * with max_resident set, a generated process is only admitted while fewer
+ * than that many processes are ready, sleeping or running. past the limit
+ * admission_policy decides: block stalls the generator, drop rejects the
+ * arrival, spill writes a 16 byte record to disk and the process is built
+ * once there is room again.
+ * */
+struct AdmissionStats {
+	uint64_t admitted = 0;
+	uint64_t dropped = 0;
+	uint64_t spilled = 0;
+	uint64_t refilled = 0;
+	uint64_t blocked = 0;	// generator ticks spent waiting for room
+
+	//gauges at the time of the copy
+	size_t resident = 0;
+	size_t ready = 0;
+	size_t sleeping = 0;
+	size_t spillDepth = 0;
+	size_t ioWaiting = 0;	// blocked on READ or WRITE
+};
+
+//what is left of a spilled process, enough to rebuild it with the same identity
+struct SpillRecord {
+	int32_t pid;
+	int32_t arrivalCycle;
+	int64_t arrivalNs;		// steady clock, so latency still counts the time on disk
+};
+
+/*
+ * fifo of spill records in an append-only file
+ *
+ * the file is created on the first push and truncated whenever the queue
+ * drains, so it only ever holds the current backlog
+ * */
+class SpillQueue {
+	string path;
+	fstream file;
+	uint64_t readPos;
+	uint64_t writePos;
+
+	static atomic<int>& instances() {
+		static atomic<int> n{0};
+		return n;
+	}
+
+	bool open() {
+		file.close();
+		file.clear();
+		file.open(path, ios::in | ios::out | ios::binary | ios::trunc);
+		readPos = writePos = 0;
+		return file.is_open();
+	}
+
+public:
+	//every scheduler gets its own file, csopesy-spill.<pid>.<n>.bin
+	SpillQueue() :
+		path("csopesy-spill." + to_string(processTag()) + "." + to_string(instances()++) + ".bin"),
+		readPos(0),
+		writePos(0)
+	{}
+
+	~SpillQueue() {
+		if(file.is_open()) {
+			file.close();
+			error_code ec;
+			filesystem::remove(path, ec);
+		}
+	}
+
+	SpillQueue(const SpillQueue&) = delete;
+	SpillQueue& operator=(const SpillQueue&) = delete;
+
+	bool push(const SpillRecord& rec) {
+		if(!file.is_open() && !open()) return false;
+		file.seekp(writePos);
+		file.write(reinterpret_cast<const char*>(&rec), sizeof(rec));
+		if(!file) {
+			file.clear();
+			return false;
+		}
+		writePos += sizeof(rec);
+		return true;
+	}
+
+	bool pop(SpillRecord& rec) {
+		if(empty()) return false;
+		file.flush();
+		file.seekg(readPos);
+		file.read(reinterpret_cast<char*>(&rec), sizeof(rec));
+		if(!file) {
+			file.clear();
+			return false;
+		}
+		readPos += sizeof(rec);
+		if(empty()) open();
+		return true;
+	}
+
+	//the backlog oldest first, left on the queue
+	vector<SpillRecord> records() {
+		vector<SpillRecord> out(size());
+		if(out.empty()) return out;
+		file.flush();
+		file.seekg(readPos);
+		file.read(reinterpret_cast<char*>(out.data()), out.size() * sizeof(SpillRecord));
+		if(!file) {
+			file.clear();
+			return {};
+		}
+		return out;
+	}
+
+	bool empty() const { return readPos == writePos; }
+	size_t size() const { return (writePos - readPos) / sizeof(SpillRecord); }
+};
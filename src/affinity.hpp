@@ -0,0 +1,121 @@
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+ * pins the calling thread to one host cpu
+ *
+ * @param cpu - host cpu index
+ * @returns bool - false where pinning is not supported or the call failed
+ * */
+bool pinThread(int cpu) {
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+/*
+ * parses a cpu list such as "0,2,4-7"
+ *
+ * @returns vector<int> - the cpus in the given order, empty if malformed
+ * */
+vector<int> parseCpuList(const string& list) {
+	vector<int> cpus;
+	stringstream ss(list);
+	string item;
+	try {
+		while(getline(ss, item, ',')) {
+			size_t dash = item.find('-');
+			if(dash == string::npos) {
+				cpus.push_back(stoi(item));
+			} else {
+				int lo = stoi(item.substr(0, dash));
+				int hi = stoi(item.substr(dash + 1));
+				for(int c = lo; c <= hi; c++) cpus.push_back(c);
+			}
+		}
+	} catch(...) {
+		return {};
+	}
+	return cpus;
+}
+
+//reads one integer from sysfs, -1 if it is missing
+int readTopology(int cpu, const string& field) {
+	ifstream in("/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/" + field);
+	int value = -1;
+	if(!(in >> value)) return -1;
+	return value;
+}
+
+/*
+ * host cpus in the order simulated cores or pool workers should be pinned
+ *
+ * compact fills the hyperthreads of one physical core and the cores of one
+ * package before moving on, so neighbouring workers share caches. scatter
+ * spreads workers over packages and physical cores first so each gets as
+ * much cache to itself as possible. list uses the given cpus verbatim.
+ *
+ * @param policy - none, compact, scatter or list
+ * @param list - cpu list for the list policy
+ * @returns vector<int> - empty when nothing should be pinned
+ * */
+vector<int> placementOrder(const string& policy, const string& list) {
+	if(policy == "none") return {};
+	if(policy == "list") return parseCpuList(list);
+
+	vector<int> allowed;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for(int c = 0; c < CPU_SETSIZE; c++) {
+			if(CPU_ISSET(c, &set)) allowed.push_back(c);
+		}
+	}
+#endif
+	if(allowed.empty()) return {};
+
+	struct Slot {
+		int cpu;
+		int package;
+		int coreRank;
+		int sibling;
+	};
+	vector<Slot> slots;
+	map<pair<int, int>, int> siblings;
+	map<int, map<int, int>> coreRanks;
+	for(int cpu : allowed) {
+		int package = max(0, readTopology(cpu, "physical_package_id"));
+		int core = readTopology(cpu, "core_id");
+		if(core < 0) core = cpu;
+
+		auto &ranks = coreRanks[package];
+		if(!ranks.count(core)) {
+			int rank = ranks.size();
+			ranks[core] = rank;
+		}
+		slots.push_back({cpu, package, ranks[core], siblings[{package, core}]++});
+	}
+
+	if(policy == "compact") {
+		sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) {
+			return tie(a.package, a.coreRank, a.sibling) < tie(b.package, b.coreRank, b.sibling);
+		});
+	} else {
+		sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) {
+			return tie(a.sibling, a.coreRank, a.package) < tie(b.sibling, b.coreRank, b.package);
+		});
+	}
+
+	vector<int> order;
+	for(auto &slot : slots) order.push_back(slot.cpu);
+	return order;
+}
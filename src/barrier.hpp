@@ -0,0 +1,65 @@
+/*
+ * static combining tree barrier for the lockstep clock
+ *
+ * participant i reports to participant (i - 1) / FAN_IN once all of its own
+ * children have reported, so no counter is written by more than FAN_IN
+ * threads per phase. the root runs the completion step alone, while every
+ * other participant is held, and then releases them all by flipping a single
+ * sense flag they only read.
+ * */
+class TreeBarrier {
+	static constexpr int FAN_IN = 4;
+
+	struct alignas(64) Node {
+		atomic<int> arrived{0};
+		int children = 0;
+	};
+
+	vector<Node> nodes;
+	alignas(64) atomic<bool> sense;
+
+	//spins briefly, then yields, then sleeps so idle phases do not burn a cpu
+	template <typename Pred>
+	static void waitFor(Pred done) {
+		for(int i = 0; !done(); i++) {
+			if(i < 64) continue;
+			if(i < 2048) this_thread::yield();
+			else this_thread::sleep_for(chrono::microseconds(50));
+		}
+	}
+
+public:
+	explicit TreeBarrier(int participants) :
+		nodes(max(1, participants)),
+		sense(false)
+	{
+		for(size_t i = 1; i < nodes.size(); i++) {
+			nodes[(i - 1) / FAN_IN].children++;
+		}
+	}
+
+	int size() const { return nodes.size(); }
+
+	/*
+	 * blocks until every participant arrived, participant 0 runs completion
+	 *
+	 * @param i - index of the caller, each index is used by one thread
+	 * @param localSense - owned by the caller, starts false
+	 * @param completion - runs once per phase before anyone is released
+	 * */
+	template <typename Fn>
+	void arrive(int i, bool& localSense, Fn completion) {
+		Node& node = nodes[i];
+		localSense = !localSense;
+		waitFor([&]() { return node.arrived.load(memory_order_acquire) == node.children; });
+		node.arrived.store(0, memory_order_relaxed);
+
+		if(i == 0) {
+			completion();
+			sense.store(localSense, memory_order_release);
+		} else {
+			nodes[(i - 1) / FAN_IN].arrived.fetch_add(1, memory_order_acq_rel);
+			waitFor([&]() { return sense.load(memory_order_acquire) == localSense; });
+		}
+	}
+};
@@ -0,0 +1,185 @@
+/*
+ * headless batch mode
+ *
+ * runs the scheduler test from command line arguments without reading stdin
+ * and writes a json summary, meant for scripted parameter sweeps:
+ *
+ *   main --batch --config config.txt --scheduler rr --cycles 200 --out run.json
+ *   main --batch --processes 500 --set num_cpu=8 --set quantum_cycles=4
+ * */
+struct BatchOptions {
+	string configPath = "config.txt";
+	string outPath = "-";
+	vector<pair<string, string>> overrides;
+	long long cycles = 0;
+	long long processes = 0;
+	long long timeoutSec = 0;
+};
+
+void printBatchUsage() {
+	cerr << "usage: main --batch [--config <file>] [--scheduler fcfs|rr]\n"
+		<< "            (--cycles <n> | --processes <n>) [--timeout <sec>]\n"
+		<< "            [--set key=value]... [--out <file>|-]" << endl;
+}
+
+/*
+ * @param argc, argv - arguments of main
+ * @param opts - filled in on success
+ * @returns bool - false on malformed arguments
+ * */
+bool parseBatchArgs(int argc, char* argv[], BatchOptions& opts) {
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		auto next = [&]() -> optional<string> {
+			if(i + 1 >= argc) return nullopt;
+			return string(argv[++i]);
+		};
+
+		try {
+			if(arg == "--batch") {
+				continue;
+			} else if(arg == "--config") {
+				auto v = next(); if(!v) return false;
+				opts.configPath = *v;
+			} else if(arg == "--out") {
+				auto v = next(); if(!v) return false;
+				opts.outPath = *v;
+			} else if(arg == "--scheduler") {
+				auto v = next(); if(!v) return false;
+				opts.overrides.push_back({"scheduler", *v});
+			} else if(arg == "--set") {
+				auto v = next(); if(!v) return false;
+				size_t eq = v->find('=');
+				if(eq == string::npos) return false;
+				opts.overrides.push_back({v->substr(0, eq), v->substr(eq + 1)});
+			} else if(arg == "--cycles") {
+				auto v = next(); if(!v) return false;
+				opts.cycles = stoll(*v);
+			} else if(arg == "--processes") {
+				auto v = next(); if(!v) return false;
+				opts.processes = stoll(*v);
+			} else if(arg == "--timeout") {
+				auto v = next(); if(!v) return false;
+				opts.timeoutSec = stoll(*v);
+			} else {
+				return false;
+			}
+		} catch(...) {
+			return false;
+		}
+	}
+	return opts.cycles > 0 || opts.processes > 0;
+}
+
+//p50/p90/p99/max of one histogram as a json object, in milliseconds
+string latencyJson(const LatencyHistogram& h) {
+	stringstream ss;
+	ss << "{\"count\":" << h.getCount()
+		<< ",\"p50_ms\":" << h.percentile(50) / 1000.0
+		<< ",\"p90_ms\":" << h.percentile(90) / 1000.0
+		<< ",\"p99_ms\":" << h.percentile(99) / 1000.0
+		<< ",\"max_ms\":" << h.getMax() / 1000.0 << "}";
+	return ss.str();
+}
+
+/*
+ * runs one batch and writes its summary
+ *
+ * @returns int - process exit code
+ * */
+int runBatch(const BatchOptions& opts) {
+	Config cfg;
+	if(!cfg.loadFile(opts.configPath))
+		return 1;
+	for(auto &[key, value] : opts.overrides) {
+		int error = cfg.set(key, value);
+		if(error != 0) {
+			Config::printError(error, key);
+			return 1;
+		}
+	}
+	if(int error = cfg.validate()) {
+		Config::printError(error, "");
+		return 1;
+	}
+
+	string summary;
+	{
+		Scheduler scheduler;
+		scheduler.configure(cfg);
+		minIns = cfg.minIns;
+		maxIns = cfg.maxIns;
+		workloadSeed = cfg.seed >= 0 ? cfg.seed : time(nullptr);
+
+		//a lockstep run stops at exactly --cycles, and generating from the
+		//first cycle on keeps it reproducible
+		scheduler.setCycleLimit((int)min<long long>(opts.cycles, numeric_limits<int>::max()));
+		scheduler.startTest(false);
+		auto started = SteadyClock::now();
+		scheduler.start();
+
+		bool timedOut = false;
+		while(true) {
+			if(opts.cycles > 0 && scheduler.getCycle() >= opts.cycles) break;
+			if(opts.processes > 0 && (long long)scheduler.getFinishedCount() >= opts.processes) break;
+			if(opts.timeoutSec > 0 &&
+				chrono::duration_cast<chrono::seconds>(SteadyClock::now() - started).count() >= opts.timeoutSec) {
+				timedOut = true;
+				break;
+			}
+			this_thread::sleep_for(chrono::milliseconds(10));
+		}
+
+		CounterTotals totals = scheduler.totals();
+		AdmissionStats admission = scheduler.admissionStats();
+		double secs = chrono::duration<double>(SteadyClock::now() - started).count();
+		int cycles = scheduler.getCycle();
+		size_t done = scheduler.getFinishedCount();
+
+		stringstream ss;
+		ss << "{\"scheduler\":\"" << scheduler.getMode() << "\""
+			<< ",\"num_cpu\":" << scheduler.getCoreCount()
+			<< ",\"quantum_cycles\":" << scheduler.getQuantum()
+			<< ",\"delays_per_exec\":" << scheduler.getExecDelay()
+			<< ",\"seed\":" << workloadSeed
+			<< ",\"timed_out\":" << (timedOut ? "true" : "false")
+			<< ",\"wall_seconds\":" << secs
+			<< ",\"cycles\":" << cycles
+			<< ",\"processes_created\":" << nextId.load()
+			<< ",\"processes_finished\":" << done
+			<< ",\"ready_queue\":" << scheduler.getReadyCount()
+			<< ",\"throughput_per_sec\":" << (secs > 0 ? done / secs : 0)
+			<< ",\"throughput_per_cycle\":" << (cycles > 0 ? 1.0 * done / cycles : 0)
+			<< ",\"instructions\":" << totals.instructions
+			<< ",\"instructions_per_sec\":" << (secs > 0 ? totals.instructions / secs : 0)
+			<< ",\"context_switches\":" << totals.contextSwitches
+			<< ",\"migrations\":" << totals.migrations
+			<< ",\"dropped\":" << admission.dropped
+			<< ",\"spilled\":" << admission.spilled
+			<< ",\"utilization_pct\":" << totals.utilization();
+
+		LatencyStats* latency = scheduler.getLatency(scheduler.getMode());
+		if(latency) {
+			ss << ",\"turnaround\":" << latencyJson(latency->turnaround)
+				<< ",\"waiting\":" << latencyJson(latency->waiting)
+				<< ",\"response\":" << latencyJson(latency->response);
+		}
+		ss << "}\n";
+		summary = ss.str();
+
+		scheduler.stopTest();
+		scheduler.stopScheduler(false);
+	}
+
+	if(opts.outPath == "-") {
+		cout << summary;
+	} else {
+		ofstream out(opts.outPath, ios::trunc);
+		if(!out.is_open()) {
+			cerr << "[Error] Could not open " << opts.outPath << endl;
+			return 1;
+		}
+		out << summary;
+	}
+	return 0;
+}
@@ -0,0 +1,366 @@
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <optional>
+#include <unordered_map>
+#include <random>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+/* HEADERS *****************/
+#include "instruction.hpp"
+#include "interner.hpp"
+#include "logsink.hpp"
+#include "counters.hpp"
+#include "trace.hpp"
+#include "coroutine.hpp"
+#include "initialize.hpp"
+#include "process.hpp"
+#include "helper.hpp"
+#include "stats.hpp"
+#include "admission.hpp"
+#include "io.hpp"
+#include "checkpoint.hpp"
+#include "report.hpp"
+#include "console.hpp"
+#include "lockstat.hpp"
+#include "affinity.hpp"
+#include "barrier.hpp"
+#include "scheduler.hpp"
+/****************************/
+
+/*
+ * scheduler benchmark
+ *
+ * builds synthetic workloads, feeds them straight into a Scheduler and
+ * measures how fast every mode drains them at each core count:
+ *
+ *   bench --modes fcfs,rr --cores 1,4,16,64 --workloads uniform,sleep --procs 500 --format csv
+ *   bench --backend coroutine (needs -std=c++20)
+ *   bench --exec-model pool --cores 1024,16384
+ * */
+struct BenchOptions {
+	vector<string> modes = {"fcfs", "rr"};
+	vector<int> cores = {1, 2, 4, 8, 16, 32, 64, 128};
+	vector<string> workloads = {"uniform", "heavy", "sleep", "print", "for"};
+	int procs = 500;
+	int quantum = 5;
+	int delay = 0;
+	int migrationCost = 0;
+	string execModel = "threads";
+	int execWorkers = 0;
+	string backend = "step";
+	string format = "csv";
+	string out = "-";
+};
+
+struct BenchResult {
+	string mode;
+	int cores;
+	string workload;
+	int procs;
+	long long instructions = 0;
+	double seconds = 0;
+	double dispatchPerSec = 0;
+	double instrPerSec = 0;
+	double switchNs = 0;
+	long long migrations = 0;
+	double rssPerProc = 0;
+	double bytesPerProc = 0;
+	double bytesPerInstr = 0;
+	double legacyBytesPerInstr = 0;	// the same programs as Instruction strings, before packing
+	double p99TurnaroundMs = 0;
+};
+
+vector<string> splitList(const string& list) {
+	vector<string> out;
+	stringstream ss(list);
+	string item;
+	while(getline(ss, item, ',')) {
+		if(!item.empty()) out.push_back(item);
+	}
+	return out;
+}
+
+//resident set size in bytes, 0 where /proc is not available
+size_t residentBytes() {
+	ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	if(!(statm >> pages >> resident)) return 0;
+#ifndef _WIN32
+	return resident * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+//what an instruction held as strings, the way processes stored their programs before packing
+size_t legacyInstructionBytes(const Instruction& instr) {
+	auto heap = [](const string& str) {
+		return str.capacity() > 15 ? str.capacity() + 1 : 0;
+	};
+	size_t bytes = sizeof(Instruction) + heap(instr.operation) + instr.arguments.capacity() * sizeof(string);
+	for(auto &arg : instr.arguments) bytes += heap(arg);
+	return bytes;
+}
+
+/*
+ * builds one process of the given workload shape
+ *
+ * @param shape - uniform, heavy, sleep, print or for
+ * @param rng - seeded so every run sees the same programs
+ * @param legacyBytes - incremented by legacyInstructionBytes of every instruction
+ * */
+unique_ptr<Process> makeWorkloadProcess(const string& shape, mt19937& rng, size_t& legacyBytes) {
+	int pid = nextId.fetch_add(1);
+	auto p = make_unique<Process>(pid, "BENCH-" + to_string(pid));
+	auto add = [&](const Instruction& instr) {
+		legacyBytes += legacyInstructionBytes(instr);
+		p->addInstruction(instr);
+	};
+
+	auto pick = [&](int lo, int hi) { return uniform_int_distribution<int>(lo, hi)(rng); };
+	auto var = [&]() { return "VAR" + to_string(pick(0, 2)); };
+
+	int len = pick(50, 150);
+	if(shape == "heavy") {
+		//pareto tail, most processes are short and a few are very long
+		double u = uniform_real_distribution<double>(0.0001, 1.0)(rng);
+		len = min(50 * 100, (int)(50 / pow(u, 1.0 / 1.2)));
+	}
+
+	for(int i = 0; i < len; i++) {
+		int roll = pick(0, 99);
+		if(shape == "sleep" && roll < 30) {
+			add(Instruction("SLEEP", {to_string(pick(1, 5))}));
+		} else if(shape == "print" && roll < 70) {
+			add(Instruction("PRINT", {"Hello World!"}));
+		} else if(shape == "for" && roll < 20) {
+			vector<Instruction> loop = processForLoop(pick(1, 3));
+			for(auto &instr : loop) add(instr);
+			i += loop.size() - 1;
+		} else if(roll % 4 == 0) {
+			add(Instruction("DECLARE", {var(), to_string(pick(1, 50))}));
+		} else if(roll % 4 == 1) {
+			add(Instruction("ADD", {var(), var(), to_string(pick(1, 50))}));
+		} else if(roll % 4 == 2) {
+			add(Instruction("SUBTRACT", {var(), var(), var()}));
+		} else {
+			add(Instruction("PRINT", {"Hello World!"}));
+		}
+	}
+	return p;
+}
+
+/*
+ * the emulator configuration of one run, checked like a config file
+ *
+ * @returns int - 0 on success, otherwise the Config error code
+ * */
+int benchConfig(const BenchOptions& opts, const string& mode, int coreCount, Config& cfg) {
+	cfg.batchFreq = 1;
+	cfg.minIns = 50;
+	cfg.maxIns = 150;
+	const pair<string, string> keys[] = {
+		{"num_cpu", to_string(coreCount)},
+		{"scheduler", mode},
+		{"quantum_cycles", to_string(opts.quantum)},
+		{"delays_per_exec", to_string(opts.delay)},
+		{"migration_cost", to_string(opts.migrationCost)},
+		{"exec_model", opts.execModel},
+		{"exec_workers", to_string(opts.execWorkers)},
+		{"exec_backend", opts.backend},
+	};
+	for(auto &[key, value] : keys) {
+		if(int error = cfg.set(key, value)) {
+			Config::printError(error, key);
+			return error;
+		}
+	}
+	if(int error = cfg.validate()) {
+		Config::printError(error, "");
+		return error;
+	}
+	return 0;
+}
+
+BenchResult runBench(const BenchOptions& opts, const Config& cfg, const string& shape) {
+	const string& mode = cfg.scheduler;
+	int coreCount = cfg.numcpu;
+	BenchResult r{mode, coreCount, shape, opts.procs};
+	mt19937 rng(12345);
+
+	Scheduler scheduler;
+	scheduler.configure(cfg);
+
+	//build the whole workload up front so memory is measured in isolation
+	size_t rssBefore = residentBytes();
+	vector<unique_ptr<Process>> workload;
+	size_t bytes = 0, programBytes = 0, legacyBytes = 0;
+	long long instrCount = 0;
+	for(int i = 0; i < opts.procs; i++) {
+		workload.push_back(makeWorkloadProcess(shape, rng, legacyBytes));
+		bytes += workload.back()->footprint();
+		programBytes += workload.back()->programBytes();
+		instrCount += workload.back()->getInstructionCount();
+	}
+	size_t rssAfter = residentBytes();
+	r.rssPerProc = rssAfter > rssBefore ? 1.0 * (rssAfter - rssBefore) / opts.procs : 0;
+	r.bytesPerProc = 1.0 * bytes / opts.procs;
+	r.bytesPerInstr = instrCount ? 1.0 * bytes / instrCount : 0;
+	//the same processes with the packed program swapped for the old layout
+	r.legacyBytesPerInstr = instrCount ? 1.0 * (bytes - programBytes + legacyBytes) / instrCount : 0;
+
+	for(auto &p : workload) scheduler.addProcess(move(p));
+
+	auto started = SteadyClock::now();
+	scheduler.start();
+	while((int)scheduler.getFinishedCount() < opts.procs) {
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	r.seconds = chrono::duration<double>(SteadyClock::now() - started).count();
+	scheduler.stopScheduler(false);
+
+	CounterTotals totals = scheduler.totals();
+	r.instructions = totals.instructions;
+	r.dispatchPerSec = totals.contextSwitches / r.seconds;
+	r.instrPerSec = totals.instructions / r.seconds;
+	r.switchNs = totals.contextSwitches ? 1.0 * totals.switchNs / totals.contextSwitches : 0;
+	r.migrations = totals.migrations;
+
+	LatencyStats* latency = scheduler.getLatency(mode);
+	r.p99TurnaroundMs = latency ? latency->turnaround.percentile(99) / 1000.0 : 0;
+	return r;
+}
+
+void writeResults(ostream& out, const vector<BenchResult>& results, const string& format) {
+	if(format == "json") {
+		out << "[\n";
+		for(size_t i = 0; i < results.size(); i++) {
+			const BenchResult& r = results[i];
+			out << "{\"mode\":\"" << r.mode << "\",\"cores\":" << r.cores
+				<< ",\"workload\":\"" << r.workload << "\",\"procs\":" << r.procs
+				<< ",\"instructions\":" << r.instructions
+				<< ",\"seconds\":" << r.seconds
+				<< ",\"dispatch_per_sec\":" << r.dispatchPerSec
+				<< ",\"instr_per_sec\":" << r.instrPerSec
+				<< ",\"switch_ns\":" << r.switchNs
+				<< ",\"migrations\":" << r.migrations
+				<< ",\"rss_bytes_per_proc\":" << r.rssPerProc
+				<< ",\"bytes_per_proc\":" << r.bytesPerProc
+				<< ",\"bytes_per_instr\":" << r.bytesPerInstr
+				<< ",\"legacy_bytes_per_instr\":" << r.legacyBytesPerInstr
+				<< ",\"p99_turnaround_ms\":" << r.p99TurnaroundMs << "}"
+				<< (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		out << "]\n";
+		return;
+	}
+
+	out << "mode,cores,workload,procs,instructions,seconds,dispatch_per_sec,instr_per_sec,"
+		<< "switch_ns,migrations,rss_bytes_per_proc,bytes_per_proc,bytes_per_instr,legacy_bytes_per_instr,p99_turnaround_ms\n";
+	for(const BenchResult& r : results) {
+		out << r.mode << "," << r.cores << "," << r.workload << "," << r.procs << ","
+			<< r.instructions << "," << r.seconds << "," << r.dispatchPerSec << ","
+			<< r.instrPerSec << "," << r.switchNs << "," << r.migrations << "," << r.rssPerProc << ","
+			<< r.bytesPerProc << "," << r.bytesPerInstr << "," << r.legacyBytesPerInstr << ","
+			<< r.p99TurnaroundMs << "\n";
+	}
+}
+
+void printBenchUsage() {
+	cerr << "usage: bench [--modes fcfs,rr] [--cores 1,4,...] [--workloads uniform,heavy,sleep,print,for]\n"
+		<< "             [--procs <n>] [--quantum <n>] [--delay <n>] [--migration-cost <n>]\n"
+		<< "             [--exec-model threads|pool] [--exec-workers <n>] [--backend step|coroutine]\n"
+		<< "             [--format csv|json] [--out <file>|-]" << endl;
+}
+
+/*
+ * @param argc, argv - arguments of main
+ * @param opts - filled in on success
+ * @returns bool - false on malformed arguments
+ * */
+bool parseBenchArgs(int argc, char* argv[], BenchOptions& opts) {
+	const vector<string> shapes = {"uniform", "heavy", "sleep", "print", "for"};
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if(i + 1 >= argc) return false;
+		string value = argv[++i];
+
+		try {
+			if(arg == "--modes") opts.modes = splitList(value);
+			else if(arg == "--workloads") opts.workloads = splitList(value);
+			else if(arg == "--procs") opts.procs = stoi(value);
+			else if(arg == "--quantum") opts.quantum = stoi(value);
+			else if(arg == "--delay") opts.delay = stoi(value);
+			else if(arg == "--migration-cost") opts.migrationCost = stoi(value);
+			else if(arg == "--exec-model") opts.execModel = value;
+			else if(arg == "--exec-workers") opts.execWorkers = stoi(value);
+			else if(arg == "--backend") opts.backend = value;
+			else if(arg == "--format") opts.format = value;
+			else if(arg == "--out") opts.out = value;
+			else if(arg == "--cores") {
+				opts.cores.clear();
+				for(auto &c : splitList(value)) opts.cores.push_back(stoi(c));
+			}
+			else return false;
+		} catch(...) {
+			return false;
+		}
+	}
+
+	for(auto &shape : opts.workloads) {
+		if(find(shapes.begin(), shapes.end(), shape) == shapes.end()) return false;
+	}
+	return opts.procs >= 1 && !opts.modes.empty() && !opts.cores.empty() && !opts.workloads.empty()
+		&& (opts.format == "csv" || opts.format == "json");
+}
+
+int main(int argc, char* argv[])
+{
+	BenchOptions opts;
+	if (!parseBenchArgs(argc, argv, opts))
+	{
+		printBenchUsage();
+		return 2;
+	}
+
+	//every combination is checked before the first run starts
+	vector<Config> configs;
+	for (auto &mode : opts.modes)
+	{
+		for (int cores : opts.cores)
+		{
+			Config cfg;
+			if (benchConfig(opts, mode, cores, cfg) != 0)
+				return 1;
+			configs.push_back(cfg);
+		}
+	}
+
+	vector<BenchResult> results;
+	for (auto &shape : opts.workloads)
+	{
+		for (auto &cfg : configs)
+		{
+			cerr << "bench " << cfg.scheduler << " cores=" << cfg.numcpu << " workload=" << shape << endl;
+			results.push_back(runBench(opts, cfg, shape));
+		}
+	}
+
+	if (opts.out == "-")
+	{
+		writeResults(cout, results, opts.format);
+	}
+	else
+	{
+		ofstream out(opts.out, ios::trunc);
+		writeResults(out, results, opts.format);
+	}
+}
@@ -0,0 +1,542 @@
+#include <limits>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+/*
+ * checkpoint file format
+ *
+ * a fixed header followed by 8 byte aligned sections. the header says where
+ * each section starts, and every record is a fixed size struct followed by
+ * its variable parts, so a mapped file is parsed in place without stream
+ * reads. programs are stored as the process holds them, PackedInstructions
+ * and the variable slots they index, so a restore copies them back without
+ * parsing. strings (variable names, PRINT messages) are stored once in a
+ * table and referenced by index. the layout is the host's, a checkpoint is
+ * restored on the kind of machine that wrote it.
+ *
+ * steady clock times are stored as nanoseconds before the checkpoint was
+ * taken, so latencies carry on from the restore as if no time had passed.
+ * */
+constexpr char CHECKPOINT_MAGIC[8] = {'C', 'S', 'O', 'P', 'C', 'K', 'P', 'T'};
+constexpr uint32_t CHECKPOINT_VERSION = 2;
+
+enum CheckpointSection : uint32_t {
+	CKPT_CONFIG,		// config keys as text, one "key value" per line
+	CKPT_STATE,			// CheckpointState and the spill backlog
+	CKPT_STRINGS,		// variable names
+	CKPT_MESSAGES,		// the PRINT message table
+	CKPT_PROCESSES,		// CheckpointProcess records in queue order
+	CKPT_CORES,			// CheckpointCore records
+	CKPT_HISTOGRAMS,	// latency histograms per mode and per core
+	CKPT_LOGS,			// PRINT log records
+	CKPT_SECTIONS
+};
+
+enum CheckpointQueue : int32_t {
+	CKPT_READY,
+	CKPT_SLEEPING,
+	CKPT_FINISHED,
+	CKPT_ON_CORE,
+	CKPT_IO_WAIT		// queued on a device, the request is issued again on restore
+};
+
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t sectionCount;
+	uint64_t fileBytes;
+	int64_t createdAt;		// wall clock, for the restore message
+	struct {
+		uint64_t offset;
+		uint64_t bytes;
+	} sections[CKPT_SECTIONS];
+};
+
+struct CheckpointState {
+	int64_t cpuCycle;
+	int64_t nextId;
+	int64_t autoReport;
+	int64_t testing;		// scheduler-test was running
+	uint64_t admitted;
+	uint64_t dropped;
+	uint64_t spilled;
+	uint64_t refilled;
+	uint64_t blocked;
+	uint64_t spillCount;	// SpillRecords that follow, arrivalNs relative like the rest
+};
+
+//followed by the name, padded to 8 bytes, then the slots and the program
+struct CheckpointProcess {
+	int32_t pid;
+	int32_t queue;
+	int32_t core;			// core holding it for CKPT_ON_CORE
+	int32_t instructionPointer;
+	int32_t sleepTimer;
+	uint32_t logCount;
+	int32_t arrivalCycle;
+	int32_t firstDispatchCycle;
+	int32_t completionCycle;
+	int32_t lastCore;
+	int32_t migrations;
+	uint32_t nameBytes;
+	uint32_t instructionCount;	// PackedInstructions, PRINT's a is a CKPT_MESSAGES index
+	uint32_t slotCount;			// CheckpointSlots
+	uint8_t arrived;
+	uint8_t dispatched;
+	uint16_t pad16;
+	uint32_t pad32;
+	int64_t arrivalAgo;
+	int64_t firstDispatchAgo;
+	int64_t completionAgo;
+	int64_t readyAgo;
+	uint64_t cpuNs;
+	int64_t lastLog;
+};
+static_assert(sizeof(CheckpointProcess) == 112, "checkpoint process records must stay 112 bytes");
+
+//a variable slot of a process, in slot order
+struct CheckpointSlot {
+	uint32_t name;			// CKPT_STRINGS index
+	int32_t value;
+	uint32_t declared;
+};
+static_assert(sizeof(CheckpointSlot) == 12, "checkpoint slots must stay 12 bytes");
+
+//CoreCounters in the order of coreCounterFields
+constexpr size_t CHECKPOINT_COUNTERS = 12;
+
+struct CheckpointCore {
+	int32_t id;
+	int32_t sliceLeft;
+	int32_t stallLeft;
+	int32_t waitLeft;
+	uint64_t counters[CHECKPOINT_COUNTERS];
+};
+
+//LogRecord without the atomic
+struct CheckpointLog {
+	int32_t pid;
+	int32_t core;
+	uint32_t msgId;
+	uint32_t seq;
+	int64_t cycle;
+	int64_t timestamp;
+};
+static_assert(sizeof(CheckpointLog) == sizeof(LogRecord), "checkpoint logs mirror log records");
+
+const array<atomic<uint64_t> CoreCounters::*, CHECKPOINT_COUNTERS> coreCounterFields = {
+	&CoreCounters::instructions, &CoreCounters::busyTicks, &CoreCounters::idleTicks,
+	&CoreCounters::contextSwitches, &CoreCounters::quantumExpiries, &CoreCounters::sleeps,
+	&CoreCounters::lockWaitNs, &CoreCounters::switchNs, &CoreCounters::busyNs,
+	&CoreCounters::idleNs, &CoreCounters::migrations, &CoreCounters::migrationStalls
+};
+
+//one histogram as read back from a checkpoint
+struct HistogramImage {
+	vector<pair<uint64_t, uint64_t>> buckets;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+};
+
+//what a core gets back when it is built after a restore
+struct CoreImage {
+	bool present = false;
+	unique_ptr<Process> current;
+	int sliceLeft = 0;
+	int stallLeft = 0;
+	int waitLeft = 0;
+	array<uint64_t, CHECKPOINT_COUNTERS> counters{};
+	array<HistogramImage, 3> latency;	// turnaround, waiting, response
+};
+
+/*
+ * append-only section buffer
+ * */
+class CheckpointBuffer {
+	string data;
+
+public:
+	template <typename T>
+	void put(const T& value) {
+		data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void putBytes(const void* bytes, size_t n) {
+		data.append(static_cast<const char*>(bytes), n);
+	}
+
+	void align() {
+		data.resize((data.size() + 7) & ~size_t(7), '\0');
+	}
+
+	//count, offsets and the bytes of a string table
+	void putStrings(const vector<string>& strings) {
+		put<uint32_t>(strings.size());
+		put<uint32_t>(0);
+		uint32_t offset = 0;
+		for(auto &str : strings) {
+			put(offset);
+			offset += str.size();
+		}
+		put(offset);
+		for(auto &str : strings) putBytes(str.data(), str.size());
+		align();
+	}
+
+	void putHistogram(const LatencyHistogram& h) {
+		auto raw = h.rawBuckets();
+		put<uint32_t>(raw.size());
+		put<uint32_t>(0);
+		put<uint64_t>(h.getSum());
+		put<uint64_t>(h.getMax());
+		for(auto &[b, c] : raw) {
+			put<uint64_t>(b);
+			put<uint64_t>(c);
+		}
+	}
+
+	const string& bytes() const { return data; }
+	size_t size() const { return data.size(); }
+};
+
+/*
+ * bounds checked reader over one section of a mapped checkpoint
+ *
+ * every get fails once the section is exhausted, so a truncated or corrupt
+ * file is reported instead of read past its end
+ * */
+class CheckpointView {
+	const char* pos;
+	const char* end;
+
+public:
+	CheckpointView(const char* begin = nullptr, size_t bytes = 0) :
+		pos(begin),
+		end(begin + bytes)
+	{}
+
+	template <typename T>
+	bool get(T& value) {
+		if((size_t)(end - pos) < sizeof(T)) return false;
+		memcpy(&value, pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+
+	bool bytes(size_t n, const char*& out) {
+		if((size_t)(end - pos) < n) return false;
+		out = pos;
+		pos += n;
+		return true;
+	}
+
+	bool align(const char* base) {
+		size_t off = ((pos - base) + 7) & ~size_t(7);
+		if((size_t)(end - base) < off) return false;
+		pos = base + off;
+		return true;
+	}
+
+	bool getStrings(vector<string>& strings) {
+		uint32_t count, pad;
+		if(!get(count) || !get(pad) || (size_t)(end - pos) / 4 < (size_t)count + 1) return false;
+		vector<uint32_t> offsets(count + 1);
+		for(auto &off : offsets) get(off);
+
+		const char* blob;
+		if(!bytes(offsets[count], blob)) return false;
+		strings.resize(count);
+		for(uint32_t i = 0; i < count; i++) {
+			if(offsets[i] > offsets[i + 1]) return false;
+			strings[i].assign(blob + offsets[i], offsets[i + 1] - offsets[i]);
+		}
+		return true;
+	}
+
+	bool getHistogram(HistogramImage& h) {
+		uint32_t count, pad;
+		if(!get(count) || !get(pad) || !get(h.sum) || !get(h.max)) return false;
+		if((size_t)(end - pos) / 16 < count) return false;
+		h.buckets.resize(count);
+		for(auto &[b, c] : h.buckets) {
+			get(b);
+			get(c);
+		}
+		return true;
+	}
+
+	bool done() const { return pos == end; }
+	const char* position() const { return pos; }
+	size_t remaining() const { return end - pos; }
+};
+
+/*
+ * a checkpoint file mapped read-only, read into memory where mmap is missing
+ * */
+class CheckpointFile {
+	const char* base = nullptr;
+	size_t length = 0;
+	vector<char> copy;
+#ifndef _WIN32
+	int fd = -1;
+#endif
+
+public:
+	~CheckpointFile() {
+#ifndef _WIN32
+		if(fd >= 0) {
+			if(length) munmap(const_cast<char*>(base), length);
+			close(fd);
+		}
+#endif
+	}
+
+	bool open(const string& path) {
+#ifndef _WIN32
+		fd = ::open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) return false;
+		void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(map == MAP_FAILED) return false;
+		base = static_cast<const char*>(map);
+		length = st.st_size;
+		return true;
+#else
+		ifstream in(path, ios::binary);
+		if(!in.is_open()) return false;
+		copy.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+		base = copy.data();
+		length = copy.size();
+		return length > 0;
+#endif
+	}
+
+	/*
+	 * checks the header and returns the section readers
+	 *
+	 * @returns string - empty when the file is usable, otherwise the reason
+	 * */
+	string sections(CheckpointHeader& header, array<CheckpointView, CKPT_SECTIONS>& views) {
+		if(length < sizeof(header)) return "file too short";
+		memcpy(&header, base, sizeof(header));
+		if(memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) return "not a checkpoint";
+		if(header.version != CHECKPOINT_VERSION)
+			return "version " + to_string(header.version) + " is not supported";
+		if(header.sectionCount != CKPT_SECTIONS || header.fileBytes != length) return "file truncated";
+		for(size_t s = 0; s < CKPT_SECTIONS; s++) {
+			auto &sec = header.sections[s];
+			if(sec.offset > length || sec.bytes > length - sec.offset) return "file truncated";
+			views[s] = CheckpointView(base + sec.offset, sec.bytes);
+		}
+		return "";
+	}
+
+	const char* data() const { return base; }
+};
+
+/*
+ * converts processes to and from their checkpoint records
+ * */
+struct ProcessCodec {
+	//variable names, deduplicated
+	vector<string> strings;
+	unordered_map<string, uint32_t> ids;
+	//logs each saved process has published, indexed by pid
+	vector<uint32_t> logCounts;
+	//PRINT messages the saved instructions and logs refer to, numbered from 0
+	vector<string> messages;
+	unordered_map<uint32_t, uint32_t> messageIds;
+	SteadyClock::time_point now = SteadyClock::now();
+
+	uint32_t id(const string& str) {
+		auto it = ids.find(str);
+		if(it != ids.end()) return it->second;
+		uint32_t i = strings.size();
+		strings.push_back(str);
+		ids.emplace(str, i);
+		return i;
+	}
+
+	//the id an interned message has in this checkpoint
+	uint32_t message(uint32_t msgId) {
+		auto it = messageIds.find(msgId);
+		if(it != messageIds.end()) return it->second;
+		uint32_t i = messages.size();
+		messages.push_back(interner.lookup(msgId));
+		messageIds.emplace(msgId, i);
+		return i;
+	}
+
+	int64_t ago(SteadyClock::time_point t) const {
+		return chrono::duration_cast<chrono::nanoseconds>(now - t).count();
+	}
+
+	void save(CheckpointBuffer& buf, Process& p, CheckpointQueue queue, int core = -1) {
+		CheckpointProcess rec{};
+		rec.pid = p.pid;
+		rec.queue = queue;
+		rec.core = core;
+		rec.instructionPointer = p.instructionPointer;
+		rec.sleepTimer = p.sleepTimer;
+		rec.logCount = p.logCount.load(memory_order_acquire);
+		rec.arrivalCycle = p.arrivalCycle;
+		rec.firstDispatchCycle = p.firstDispatchCycle;
+		rec.completionCycle = p.completionCycle;
+		rec.lastCore = p.lastCore;
+		rec.migrations = p.migrations;
+		const string& name = p.getName();
+		rec.nameBytes = name.size();
+		rec.instructionCount = p.code.size();
+		rec.slotCount = p.vars.size();
+		rec.arrived = p.arrived;
+		rec.dispatched = p.dispatched;
+		rec.arrivalAgo = ago(p.arrivalTime);
+		rec.firstDispatchAgo = ago(p.firstDispatchTime);
+		rec.completionAgo = ago(p.completionTime);
+		rec.readyAgo = ago(p.readySince);
+		rec.cpuNs = p.cpuNs;
+		rec.lastLog = p.lastLog.load(memory_order_relaxed);
+		buf.put(rec);
+		buf.putBytes(name.data(), name.size());
+		buf.align();
+
+		for(auto &var : p.vars) buf.put(CheckpointSlot{id(var.name), var.value, var.declared});
+		for(PackedInstruction instr : p.code) {
+			if(instr.op == OP_PRINT) instr.a = message(instr.a);
+			buf.put(instr);
+		}
+		buf.align();
+
+		if(p.pid >= 0) {
+			if((size_t)p.pid >= logCounts.size()) logCounts.resize(p.pid + 1, 0);
+			logCounts[p.pid] = rec.logCount;
+		}
+	}
+
+	//steps over the variable part of a record, false if it runs past the section
+	static bool skip(CheckpointView& view, const char* section, const CheckpointProcess& rec) {
+		const char* at;
+		if(!view.bytes(rec.nameBytes, at) || !view.align(section)) return false;
+		return view.bytes((size_t)rec.slotCount * sizeof(CheckpointSlot), at)
+			&& view.bytes((size_t)rec.instructionCount * sizeof(PackedInstruction), at) && view.align(section);
+	}
+
+	//whether every slot and message an instruction names exists, the program is run without checks
+	static bool validInstruction(const PackedInstruction& instr, uint32_t slots, size_t messages) {
+		auto inRange = [slots](int32_t s) { return s >= 0 && (uint32_t)s < slots; };
+		if(instr.op > OP_WRITE) return false;
+		if(instr.op == OP_PRINT) return instr.a >= 0 && (size_t)instr.a < messages;
+		if((instr.op == OP_DECLARE || instr.op == OP_ADD || instr.op == OP_SUBTRACT) && !inRange(instr.dst))
+			return false;
+		if((instr.op == OP_NOP || instr.op == OP_READ || instr.op == OP_WRITE) && !(instr.kinds & KIND_A_SLOT))
+			return false;
+		if((instr.kinds & KIND_A_SLOT) && !inRange(instr.a)) return false;
+		return !(instr.kinds & KIND_B_SLOT) || inRange(instr.b);
+	}
+
+	/*
+	 * rebuilds one process
+	 *
+	 * @param strings_ - string table of the checkpoint
+	 * @param messages - message ids of the checkpoint mapped to ids in this run
+	 * @returns nullptr if the record is malformed
+	 * */
+	static unique_ptr<Process> load(CheckpointView& view, const char* section, const CheckpointProcess& rec,
+			const vector<string>& strings_, const vector<uint32_t>& messages, SteadyClock::time_point now) {
+		const char* name;
+		if(!view.bytes(rec.nameBytes, name) || !view.align(section)) return nullptr;
+
+		auto p = make_unique<Process>(rec.pid, string(name, rec.nameBytes));
+		if(view.remaining() / sizeof(CheckpointSlot) < rec.slotCount) return nullptr;
+		p->vars.reserve(rec.slotCount);
+		for(uint32_t i = 0; i < rec.slotCount; i++) {
+			CheckpointSlot slot;
+			if(!view.get(slot) || slot.name >= strings_.size()) return nullptr;
+			p->vars.push_back({strings_[slot.name], slot.value, slot.declared != 0});
+		}
+
+		const char* code;
+		if(!view.bytes((size_t)rec.instructionCount * sizeof(PackedInstruction), code) || !view.align(section))
+			return nullptr;
+		p->code.resize(rec.instructionCount);
+		if(rec.instructionCount) memcpy(p->code.data(), code, (size_t)rec.instructionCount * sizeof(PackedInstruction));
+		for(auto &instr : p->code) {
+			if(!validInstruction(instr, rec.slotCount, messages.size())) return nullptr;
+			if(instr.op == OP_PRINT) instr.a = messages[instr.a];
+		}
+		if(rec.instructionPointer < 0 || (uint32_t)rec.instructionPointer > rec.instructionCount) return nullptr;
+
+		auto at = [now](int64_t ago) { return now - chrono::nanoseconds(ago); };
+		p->instructionPointer = rec.instructionPointer;
+		p->sleepTimer = rec.sleepTimer;
+		p->ioBlocked = rec.queue == CKPT_IO_WAIT;
+		p->logCount.store(rec.logCount, memory_order_relaxed);
+		p->lastLog.store(rec.lastLog, memory_order_relaxed);
+		p->arrivalCycle = rec.arrivalCycle;
+		p->firstDispatchCycle = rec.firstDispatchCycle;
+		p->completionCycle = rec.completionCycle;
+		p->lastCore = rec.lastCore;
+		p->migrations = rec.migrations;
+		p->arrived = rec.arrived;
+		p->dispatched = rec.dispatched;
+		p->arrivalTime = at(rec.arrivalAgo);
+		p->firstDispatchTime = at(rec.firstDispatchAgo);
+		p->completionTime = at(rec.completionAgo);
+		p->readySince = at(rec.readyAgo);
+		p->cpuNs = rec.cpuNs;
+		return p;
+	}
+
+	//points a restored process at the newest of its restored logs
+	static void setLastRecord(Process& p, uint32_t record) {
+		p.lastRecord.store(record, memory_order_relaxed);
+	}
+
+	/*
+	 * gives a process that arrived from another node its local identity
+	 *
+	 * @param shift - this node's cycle minus the sender's, moves its cycle stamps onto this clock
+	 * */
+	static void relabel(Process& p, int pid, const string& name, int shift) {
+		p.pid = pid;
+		p.nameId = interner.intern(name);
+		p.lastCore = -1;
+		if(p.arrived) p.arrivalCycle += shift;
+		if(p.dispatched) p.firstDispatchCycle += shift;
+	}
+};
+
+/*
+ * writes the header and the sections to path.tmp and renames it over path
+ *
+ * @returns uint64_t - bytes written, 0 on failure
+ * */
+uint64_t writeCheckpoint(const string& path, array<CheckpointBuffer, CKPT_SECTIONS>& sections) {
+	CheckpointHeader header{};
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.sectionCount = CKPT_SECTIONS;
+	header.createdAt = time(nullptr);
+	uint64_t offset = (sizeof(header) + 7) & ~uint64_t(7);
+	for(size_t s = 0; s < CKPT_SECTIONS; s++) {
+		sections[s].align();
+		header.sections[s] = {offset, sections[s].size()};
+		offset += sections[s].size();
+	}
+	header.fileBytes = offset;
+
+	string tmp = path + ".tmp";
+	{
+		ofstream out(tmp, ios::binary | ios::trunc);
+		if(!out.is_open()) return 0;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write("\0\0\0\0\0\0\0", header.sections[0].offset - sizeof(header));
+		for(auto &sec : sections) out.write(sec.bytes().data(), sec.size());
+		if(!out) return 0;
+	}
+
+	error_code ec;
+	filesystem::rename(tmp, path, ec);
+	return ec ? 0 : header.fileBytes;
+}
@@ -0,0 +1,598 @@
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+/*
+ * cluster mode, several emulators sharing one workload
+ *
+ * every node listens on an address and dials the peers it was given, an
+ * address is unix:<path>, a path, or <host>:<port> for tcp. a link carries
+ * frames of a ClusterFrame header and its payload:
+ *
+ *   HELLO      the node name
+ *   LOAD       a ClusterLoad, sent to every peer once per interval
+ *   MIGRATE    ready processes in checkpoint form (ProcessCodec), their
+ *              PRINT logs and the PRINT messages both refer to
+ *
+ * once per interval a node compares its ready processes per core with the
+ * last report of each peer and sends half of what would even it out with
+ * the least loaded one, half since the report is already old. a node always
+ * keeps a ready process per core for itself. migrated processes get a pid
+ * from the receiving node and keep their name with @<origin> appended.
+ * */
+enum ClusterFrameType : uint32_t {
+	CLUSTER_HELLO,
+	CLUSTER_LOAD,
+	CLUSTER_MIGRATE
+};
+
+struct ClusterFrame {
+	uint32_t type;
+	uint32_t bytes;
+};
+
+//what a node reports about itself every interval
+struct ClusterLoad {
+	int64_t cycle;
+	int32_t cores;
+	int32_t pad;
+	uint64_t ready;
+	uint64_t resident;
+	uint64_t finished;
+	uint64_t instructions;
+	uint64_t migratedIn;
+	uint64_t migratedOut;
+	uint64_t room;			// processes it admits before max_resident
+	double utilization;		// percent over the last interval
+};
+
+//followed by the messages, the string table, the records and the logs
+struct ClusterMigrate {
+	uint32_t count;
+	uint32_t pad;
+	int64_t cycle;			// sender clock, to rebase the cycle stamps
+	uint64_t recordBytes;
+	uint64_t logCount;		// CheckpointLogs, pid is the index in the batch
+};
+
+//one row of the cluster table
+struct ClusterNodeStats {
+	string name;
+	string address;
+	bool local = false;
+	double age = 0;			// seconds since the report
+	ClusterLoad load{};
+};
+
+class ClusterNode {
+	static constexpr size_t MAX_FRAME = 64 << 20;
+	static constexpr size_t MIGRATE_BATCH = 256;
+
+	struct Link {
+		int fd = -1;
+		string address;				// what was dialed, empty for accepted links
+		string peer;				// from its HELLO, under ClusterNode::mtx
+		thread reader;
+		atomic<bool> done{false};
+		mutex sendMtx;
+		ClusterLoad load{};			// last report, under ClusterNode::mtx
+		SteadyClock::time_point reported;
+		bool hasLoad = false;
+	};
+
+	Scheduler& scheduler;
+	string name;
+	string address;
+	int listenFd;
+	int intervalMs;
+	atomic<bool> stop;
+	bool started;
+	thread acceptThread;
+	thread balanceThread;
+	mutex mtx;
+	condition_variable wake;
+	list<unique_ptr<Link>> links;
+	vector<string> peers;			// addresses kept dialed, under mtx
+	ClusterLoad local{};			// under mtx
+	unordered_map<int, uint32_t> departed;	// migrated pid to interned peer name, under mtx
+	CounterTotals lastTotals;		// balance thread only
+	atomic<uint64_t> migratedIn;
+	atomic<uint64_t> migratedOut;
+	mutex logMtx;
+	LogCursor cursor;				// migrated logs, under logMtx
+
+#ifndef _WIN32
+	static bool sendAll(int fd, const void* data, size_t n) {
+		const char* p = static_cast<const char*>(data);
+		while(n > 0) {
+			ssize_t sent = send(fd, p, n, MSG_NOSIGNAL);
+			if(sent <= 0) return false;
+			p += sent;
+			n -= sent;
+		}
+		return true;
+	}
+
+	//false once the peer is gone or the node stops
+	bool recvAll(int fd, void* data, size_t n) {
+		char* p = static_cast<char*>(data);
+		while(n > 0) {
+			if(stop) return false;
+			pollfd pfd{fd, POLLIN, 0};
+			int ready = poll(&pfd, 1, 200);
+			if(ready < 0) return false;
+			if(ready == 0) continue;
+			ssize_t got = recv(fd, p, n, 0);
+			if(got <= 0) return false;
+			p += got;
+			n -= got;
+		}
+		return true;
+	}
+
+	/*
+	 * binds or connects a stream socket
+	 *
+	 * @param listening - bind and listen instead of connecting
+	 * @returns int - the socket, -1 on failure
+	 * */
+	static int openSocket(const string& addr, bool listening) {
+		string path;
+		if(addr.rfind("unix:", 0) == 0) path = addr.substr(5);
+		else if(addr.find('/') != string::npos || addr.find(':') == string::npos) path = addr;
+
+		if(!path.empty()) {
+			sockaddr_un un{};
+			if(path.size() >= sizeof(un.sun_path)) return -1;
+			un.sun_family = AF_UNIX;
+			strncpy(un.sun_path, path.c_str(), sizeof(un.sun_path) - 1);
+			int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if(fd < 0) return -1;
+			if(listening) unlink(path.c_str());
+			int rc = listening ? ::bind(fd, (sockaddr*)&un, sizeof(un)) : connect(fd, (sockaddr*)&un, sizeof(un));
+			if(rc < 0 || (listening && listen(fd, 16) < 0)) {
+				close(fd);
+				return -1;
+			}
+			return fd;
+		}
+
+		size_t colon = addr.rfind(':');
+		string host = addr.substr(0, colon), port = addr.substr(colon + 1);
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = listening ? AI_PASSIVE : 0;
+		addrinfo* found;
+		if(getaddrinfo(host.empty() || host == "*" ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0)
+			return -1;
+		int fd = -1;
+		for(addrinfo* ai = found; ai && fd < 0; ai = ai->ai_next) {
+			fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+			if(fd < 0) continue;
+			int one = 1;
+			if(listening) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			else setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			int rc = listening ? ::bind(fd, ai->ai_addr, ai->ai_addrlen) : connect(fd, ai->ai_addr, ai->ai_addrlen);
+			if(rc < 0 || (listening && listen(fd, 16) < 0)) {
+				close(fd);
+				fd = -1;
+			}
+		}
+		freeaddrinfo(found);
+		return fd;
+	}
+
+	bool sendFrame(Link& link, uint32_t type, const string& payload) {
+		lock_guard<mutex> lock(link.sendMtx);
+		ClusterFrame frame{type, (uint32_t)payload.size()};
+		return sendAll(link.fd, &frame, sizeof(frame)) && sendAll(link.fd, payload.data(), payload.size());
+	}
+
+	//takes over a connected socket, greets the peer and starts reading from it
+	void addLink(int fd, const string& dialed) {
+		auto link = make_unique<Link>();
+		link->fd = fd;
+		link->address = dialed;
+		if(!sendFrame(*link, CLUSTER_HELLO, name)) {
+			close(fd);
+			return;
+		}
+		Link* l = link.get();
+		l->reader = thread([this, l]() {
+			serve(*l);
+			l->done = true;
+		});
+		lock_guard<mutex> lock(mtx);
+		links.push_back(move(link));
+	}
+
+	void serve(Link& link) {
+		ClusterFrame frame;
+		string payload;
+		while(recvAll(link.fd, &frame, sizeof(frame)) && frame.bytes <= MAX_FRAME) {
+			payload.resize(frame.bytes);
+			if(!recvAll(link.fd, &payload[0], payload.size())) break;
+
+			if(frame.type == CLUSTER_HELLO) {
+				lock_guard<mutex> lock(mtx);
+				link.peer = payload;
+			} else if(frame.type == CLUSTER_LOAD && payload.size() == sizeof(ClusterLoad)) {
+				lock_guard<mutex> lock(mtx);
+				memcpy(&link.load, payload.data(), sizeof(ClusterLoad));
+				link.reported = SteadyClock::now();
+				link.hasLoad = true;
+			} else if(frame.type == CLUSTER_MIGRATE) {
+				//a batch that does not parse means the peer speaks something else
+				if(!adopt(link, payload)) break;
+			}
+		}
+	}
+
+	/*
+	 * serializes a batch and sends it down the link
+	 *
+	 * @returns bool - false if the link failed, the batch is left untouched
+	 * */
+	bool migrate(Link& link, vector<unique_ptr<Process>>& batch) {
+		ProcessCodec codec;
+		CheckpointBuffer records, logs;
+		uint64_t logCount = 0;
+		for(size_t i = 0; i < batch.size(); i++) {
+			codec.save(records, *batch[i], CKPT_READY);
+			batch[i]->forEachLog([&](const LogRecord& rec) {
+				logs.put(CheckpointLog{(int32_t)i, rec.core, codec.message(rec.msgId), rec.seq.load(memory_order_relaxed),
+					rec.cycle, rec.timestamp});
+				logCount++;
+			});
+		}
+
+		ClusterMigrate head{(uint32_t)batch.size(), 0, scheduler.getCycle(), records.size(), logCount};
+		CheckpointBuffer buf;
+		buf.put(head);
+		buf.putStrings(codec.messages);
+		buf.putStrings(codec.strings);
+		buf.putBytes(records.bytes().data(), records.size());
+		buf.putBytes(logs.bytes().data(), logs.size());
+		if(buf.size() > MAX_FRAME) return false;
+
+		return sendFrame(link, CLUSTER_MIGRATE, buf.bytes());
+	}
+
+	//rebuilds a migrated batch and hands it to the scheduler
+	bool adopt(Link& link, const string& payload) {
+		CheckpointView view(payload.data(), payload.size());
+		ClusterMigrate head;
+		vector<string> messages, strings;
+		const char* base = payload.data();
+		if(!view.get(head) || !view.getStrings(messages) || !view.align(base) || !view.getStrings(strings)
+			|| !view.align(base))
+			return false;
+		vector<uint32_t> messageIds;
+		for(auto &msg : messages) messageIds.push_back(interner.intern(msg));
+
+		const char* section;
+		if(!view.bytes(head.recordBytes, section)) return false;
+		CheckpointView records(section, head.recordBytes);
+		string origin;
+		{
+			lock_guard<mutex> lock(mtx);
+			origin = link.peer.empty() ? "remote" : link.peer;
+		}
+		int shift = scheduler.getCycle() - (int)head.cycle;
+		SteadyClock::time_point now = SteadyClock::now();
+
+		vector<unique_ptr<Process>> batch;
+		for(uint32_t i = 0; i < head.count; i++) {
+			CheckpointProcess rec;
+			if(!records.get(rec)) return false;
+			unique_ptr<Process> p = ProcessCodec::load(records, section, rec, strings, messageIds, now);
+			if(!p) return false;
+			string label = p->getName();
+			if(label.find('@') == string::npos) label += "@" + origin;
+			ProcessCodec::relabel(*p, nextId.fetch_add(1), label, shift);
+			batch.push_back(move(p));
+		}
+
+		vector<uint32_t> lastRecord(batch.size(), LogSink::NO_RECORD);
+		{
+			lock_guard<mutex> lock(logMtx);
+			for(CheckpointLog rec; view.get(rec); ) {
+				if(rec.pid < 0 || (size_t)rec.pid >= batch.size() || rec.msgId >= messageIds.size())
+					return false;
+				uint32_t record = cursor.put(batch[rec.pid]->getPid(), rec.core, messageIds[rec.msgId],
+					rec.seq, rec.cycle, rec.timestamp, lastRecord[rec.pid]);
+				if(record == LogSink::NO_RECORD) break;
+				lastRecord[rec.pid] = record;
+			}
+		}
+		for(size_t i = 0; i < batch.size(); i++) ProcessCodec::setLastRecord(*batch[i], lastRecord[i]);
+
+		migratedIn += scheduler.addProcesses(batch, stop);
+		return true;
+	}
+
+	//closes finished links so dial() connects their peers again
+	void reap() {
+		list<unique_ptr<Link>> closed;
+		{
+			lock_guard<mutex> lock(mtx);
+			for(auto it = links.begin(); it != links.end(); ) {
+				if((*it)->done) closed.splice(closed.end(), links, it++);
+				else ++it;
+			}
+		}
+		for(auto &link : closed) {
+			//wakes a reader that is still waiting on a link given up from this side
+			::shutdown(link->fd, SHUT_RDWR);
+			if(link->reader.joinable()) link->reader.join();
+			close(link->fd);
+		}
+	}
+
+	//connects to every configured peer that has no live link
+	void dial() {
+		vector<string> missing;
+		{
+			lock_guard<mutex> lock(mtx);
+			for(auto &peer : peers) {
+				bool linked = false;
+				for(auto &link : links) linked = linked || link->address == peer;
+				if(!linked) missing.push_back(peer);
+			}
+		}
+		for(auto &peer : missing) {
+			int fd = openSocket(peer, false);
+			if(fd >= 0) addLink(fd, peer);
+		}
+	}
+
+	//this node's report, utilization over the time since the last one
+	void report() {
+		AdmissionStats a = scheduler.admissionStats();
+		CounterTotals t = scheduler.totals();
+		ClusterLoad load{};
+		load.cycle = scheduler.getCycle();
+		load.cores = scheduler.getCoreCount();
+		load.ready = a.ready;
+		load.resident = a.resident;
+		load.room = scheduler.residentRoom();
+		load.finished = scheduler.getFinishedCount();
+		load.instructions = t.instructions;
+		load.migratedIn = migratedIn;
+		load.migratedOut = migratedOut;
+		load.utilization = (t - lastTotals).utilization();
+		lastTotals = t;
+
+		string payload(reinterpret_cast<const char*>(&load), sizeof(load));
+		vector<Link*> live;
+		{
+			lock_guard<mutex> lock(mtx);
+			local = load;
+			for(auto &link : links) if(!link->done) live.push_back(link.get());
+		}
+		for(Link* link : live) {
+			if(!sendFrame(*link, CLUSTER_LOAD, payload)) link->done = true;
+		}
+	}
+
+	//moves ready processes to the least loaded peer with a fresh report
+	void balance() {
+		Link* target = nullptr;
+		ClusterLoad me, peer;
+		{
+			lock_guard<mutex> lock(mtx);
+			me = local;
+			auto stale = SteadyClock::now() - chrono::milliseconds(3 * intervalMs);
+			for(auto &link : links) {
+				if(link->done || !link->hasLoad || link->reported < stale || link->load.cores < 1) continue;
+				if(!target || link->load.ready * target->load.cores < target->load.ready * link->load.cores)
+					target = link.get();
+			}
+			if(target) peer = target->load;
+		}
+		if(!target || me.cores < 1 || me.ready <= (uint64_t)me.cores) return;
+
+		//k evens out ready per core: (ready - k) / cores == (peer.ready + k) / peer.cores
+		long long even = ((long long)me.ready * peer.cores - (long long)peer.ready * me.cores)
+			/ (me.cores + peer.cores);
+		long long k = min({even / 2, (long long)(me.ready - me.cores),
+			(long long)min<uint64_t>(peer.room, MIGRATE_BATCH)});
+		if(k < 1) return;
+
+		vector<unique_ptr<Process>> batch = scheduler.takeReady(k);
+		if(batch.empty()) return;
+		if(!migrate(*target, batch)) {
+			target->done = true;
+			scheduler.addProcesses(batch, stop);
+			return;
+		}
+		migratedOut += batch.size();
+		//counted against the peer until its next report says otherwise
+		lock_guard<mutex> lock(mtx);
+		uint32_t peerId = interner.intern(target->peer.empty() ? "remote" : target->peer);
+		for(auto &p : batch) departed[p->getPid()] = peerId;
+		target->load.ready += batch.size();
+		target->load.room -= min<uint64_t>(target->load.room, batch.size());
+	}
+#endif
+
+public:
+	explicit ClusterNode(Scheduler& scheduler_) :
+		scheduler(scheduler_),
+		listenFd(-1),
+		intervalMs(500),
+		stop(false),
+		started(false),
+		migratedIn(0),
+		migratedOut(0),
+		cursor(-1, nullptr)
+	{}
+
+	~ClusterNode() { shutdown(); }
+
+	/*
+	 * @param name_ - shown by the peers and appended to the processes sent to them
+	 * @param listenAddr - where peers connect, empty to only dial out
+	 * @param peers_ - addresses dialed now and again whenever the link drops
+	 * @returns bool - false if the listening socket could not be opened
+	 * */
+	bool start(const string& name_, const string& listenAddr, const vector<string>& peers_, int intervalMs_) {
+#ifndef _WIN32
+		shutdown();
+		name = name_;
+		address = listenAddr;
+		intervalMs = intervalMs_;
+		if(!address.empty()) {
+			listenFd = openSocket(address, true);
+			if(listenFd < 0) return false;
+		}
+		{
+			lock_guard<mutex> lock(mtx);
+			peers = peers_;
+		}
+		lastTotals = scheduler.totals();
+		stop = false;
+		started = true;
+
+		if(listenFd >= 0) {
+			acceptThread = thread([this]() {
+				while(!stop) {
+					pollfd pfd{listenFd, POLLIN, 0};
+					if(poll(&pfd, 1, 200) <= 0) continue;
+					int fd = accept(listenFd, nullptr, nullptr);
+					if(fd >= 0) addLink(fd, "");
+				}
+			});
+		}
+		balanceThread = thread([this]() {
+			while(!stop) {
+				reap();
+				dial();
+				report();
+				balance();
+				unique_lock<mutex> lock(mtx);
+				wake.wait_for(lock, chrono::milliseconds(intervalMs), [this]() { return stop.load(); });
+			}
+		});
+		return true;
+#else
+		(void)name_; (void)listenAddr; (void)peers_; (void)intervalMs_;
+		return false;
+#endif
+	}
+
+	//adds a peer to keep dialed, connected on the next interval
+	void join(const string& peer) {
+		lock_guard<mutex> lock(mtx);
+		if(find(peers.begin(), peers.end(), peer) == peers.end()) peers.push_back(peer);
+		wake.notify_all();
+	}
+
+	void shutdown() {
+#ifndef _WIN32
+		if(!started) return;
+		{
+			lock_guard<mutex> lock(mtx);
+			stop = true;
+			wake.notify_all();
+		}
+		if(acceptThread.joinable()) acceptThread.join();
+		if(balanceThread.joinable()) balanceThread.join();
+		for(auto &link : links) {
+			if(link->reader.joinable()) link->reader.join();
+			close(link->fd);
+		}
+		links.clear();
+		peers.clear();
+		if(listenFd >= 0) {
+			close(listenFd);
+			listenFd = -1;
+			if(address.rfind("unix:", 0) == 0) unlink(address.c_str() + 5);
+			else if(address.find(':') == string::npos || address.find('/') != string::npos) unlink(address.c_str());
+		}
+		started = false;
+#endif
+	}
+
+	bool isRunning() const { return started; }
+
+	//the node a process left for, empty if it never left this one
+	string migratedTo(int pid) {
+		lock_guard<mutex> lock(mtx);
+		auto it = departed.find(pid);
+		return it == departed.end() ? "" : interner.lookup(it->second);
+	}
+	const string& getName() const { return name; }
+
+	//this node first, then one row per peer that said hello
+	vector<ClusterNodeStats> nodes() {
+		vector<ClusterNodeStats> rows;
+		lock_guard<mutex> lock(mtx);
+		ClusterNodeStats self;
+		self.name = name;
+		self.address = address;
+		self.local = true;
+		self.load = local;
+		rows.push_back(self);
+
+		auto now = SteadyClock::now();
+		for(auto &link : links) {
+			if(link->done || link->peer.empty()) continue;
+			//both ends may have dialed, one row per peer
+			bool seen = false;
+			for(auto &row : rows) seen = seen || row.name == link->peer;
+			if(seen) continue;
+			ClusterNodeStats row;
+			row.name = link->peer;
+			row.address = link->address.empty() ? "(inbound)" : link->address;
+			row.load = link->load;
+			row.age = link->hasLoad ? chrono::duration<double>(now - link->reported).count() : -1;
+			rows.push_back(row);
+		}
+		return rows;
+	}
+
+	/*
+	 * per-node table plus the whole cluster, whose utilization is the
+	 * core weighted mean of the nodes'
+	 * */
+	string summary() {
+		vector<ClusterNodeStats> rows = nodes();
+		stringstream ss;
+		ss << fixed << setprecision(1);
+		ss << left << setw(16) << "node" << right << setw(7) << "cores" << setw(8) << "ready"
+			<< setw(10) << "resident" << setw(10) << "finished" << setw(8) << "util %"
+			<< setw(8) << "in" << setw(8) << "out" << "  seen" << "\n";
+
+		ClusterLoad total{};
+		double weighted = 0;
+		for(auto &row : rows) {
+			const ClusterLoad& l = row.load;
+			ss << left << setw(16) << (row.local ? row.name + "*" : row.name) << right
+				<< setw(7) << l.cores << setw(8) << l.ready << setw(10) << l.resident
+				<< setw(10) << l.finished << setw(8) << l.utilization
+				<< setw(8) << l.migratedIn << setw(8) << l.migratedOut << "  ";
+			if(row.local) ss << "local";
+			else if(row.age < 0) ss << "no report";
+			else ss << row.age << "s ago";
+			ss << "\n";
+
+			total.cores += l.cores;
+			total.ready += l.ready;
+			total.resident += l.resident;
+			total.finished += l.finished;
+			total.migratedIn += l.migratedIn;
+			total.migratedOut += l.migratedOut;
+			weighted += l.utilization * l.cores;
+		}
+		ss << left << setw(16) << "cluster" << right
+			<< setw(7) << total.cores << setw(8) << total.ready << setw(10) << total.resident
+			<< setw(10) << total.finished << setw(8) << (total.cores ? weighted / total.cores : 0.0)
+			<< setw(8) << total.migratedIn << setw(8) << total.migratedOut << "  "
+			<< rows.size() << " nodes\n";
+		return ss.str();
+	}
+};
@@ -0,0 +1,265 @@
+/*
+ * scheduler comparison on a replayable workload
+ *
+ * every variant runs on its own Scheduler with the lockstep clock, one lane,
+ * its own pid range and an in-memory log sink, and generates the same seeded
+ * workload: the same programs arriving every batch_process_freq cycles. the
+ * runs go side by side on separate threads and, being counted in cycles,
+ * give the same table for the same seed and config every time.
+ *
+ *   scheduler-compare <seed> [processes] [fcfs,rr:2,rr:8,...]
+ *   main --compare --seed 42 --processes 500 --variants fcfs,rr:4 --set num_cpu=8
+ * */
+struct CompareVariant {
+	string label;
+	string scheduler;
+	long long quantum;
+};
+
+struct CompareResult {
+	size_t finished = 0;
+	int makespan = 0;			// cycle the last process finished in
+	double meanTurnaround = 0;	// cycles from arrival to finish
+	int p99Turnaround = 0;
+	double utilization = 0;		// busy share of num_cpu * makespan core cycles
+	uint64_t contextSwitches = 0;
+	uint64_t instructions = 0;
+	uint64_t digest = 0;		// fnv-1a over the finishing order and cycles
+};
+
+struct CompareOptions {
+	string configPath = "config.txt";
+	string outPath = "-";
+	vector<pair<string, string>> overrides;
+	uint64_t seed = 0;
+	bool seeded = false;
+	int processes = 200;
+	string variants = "fcfs,rr:2,rr:4,rr:8,rr:16";
+};
+
+void printCompareUsage() {
+	cerr << "usage: main --compare --seed <n> [--processes <n>] [--variants fcfs,rr:<quantum>,...]\n"
+		<< "            [--config <file>] [--set key=value]... [--out <file>|-]" << endl;
+}
+
+/*
+ * @param list - fcfs, rr or rr:<quantum>, comma separated
+ * @param quantum - what a bare rr runs with
+ * @param variants - filled in on success
+ * @returns bool - false on an unknown mode or a bad quantum
+ * */
+bool parseVariants(const string& list, long long quantum, vector<CompareVariant>& variants) {
+	stringstream ss(list);
+	string item;
+	while(getline(ss, item, ',')) {
+		size_t colon = item.find(':');
+		CompareVariant v{item, item.substr(0, colon), quantum};
+		if(v.scheduler != "fcfs" && v.scheduler != "rr") return false;
+		if(colon != string::npos) {
+			if(v.scheduler != "rr") return false;
+			try { v.quantum = stoll(item.substr(colon + 1)); } catch(...) { return false; }
+			if(v.quantum < 1) return false;
+		} else if(v.scheduler == "rr") {
+			v.label = "rr:" + to_string(quantum);
+		}
+		variants.push_back(v);
+	}
+	return !variants.empty();
+}
+
+bool parseCompareArgs(int argc, char* argv[], CompareOptions& opts) {
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		auto next = [&]() -> optional<string> {
+			if(i + 1 >= argc) return nullopt;
+			return string(argv[++i]);
+		};
+
+		try {
+			if(arg == "--compare") {
+				continue;
+			} else if(arg == "--config") {
+				auto v = next(); if(!v) return false;
+				opts.configPath = *v;
+			} else if(arg == "--out") {
+				auto v = next(); if(!v) return false;
+				opts.outPath = *v;
+			} else if(arg == "--set") {
+				auto v = next(); if(!v) return false;
+				size_t eq = v->find('=');
+				if(eq == string::npos) return false;
+				opts.overrides.push_back({v->substr(0, eq), v->substr(eq + 1)});
+			} else if(arg == "--seed") {
+				auto v = next(); if(!v) return false;
+				opts.seed = stoull(*v);
+				opts.seeded = true;
+			} else if(arg == "--processes") {
+				auto v = next(); if(!v) return false;
+				opts.processes = stoi(*v);
+			} else if(arg == "--variants") {
+				auto v = next(); if(!v) return false;
+				opts.variants = *v;
+			} else {
+				return false;
+			}
+		} catch(...) {
+			return false;
+		}
+	}
+	return opts.seeded && opts.processes > 0;
+}
+
+/*
+ * runs the workload through one variant until every process finished or
+ * was dropped by admission control
+ *
+ * @returns nullopt if the run was cancelled first
+ * */
+optional<CompareResult> runVariant(Config cfg, const CompareVariant& v, uint64_t seed, int processes) {
+	cfg.scheduler = v.scheduler;
+	cfg.quantumCycles = v.quantum;
+	cfg.clockMode = "lockstep";
+	cfg.cycleUs = 0;
+	cfg.execModel = "pool";
+	cfg.execWorkers = 1;
+	cfg.cpuAffinity = "none";
+
+	//declared before the scheduler so its cores never outlive them
+	LogSink sink("");
+	atomic<int> ids{0};
+	Scheduler scheduler;
+	scheduler.configure(cfg);
+	scheduler.isolateWorkload(sink, ids, seed, processes);
+	scheduler.startTest(false);
+	scheduler.start();
+
+	auto settled = [&]() {
+		return scheduler.getFinishedCount() + scheduler.admissionStats().dropped >= (size_t)processes;
+	};
+	while(!settled() && !cancelRequested)
+		this_thread::sleep_for(chrono::milliseconds(5));
+	scheduler.stopTest();
+	scheduler.stopScheduler(false);
+	if(!settled())
+		return nullopt;
+
+	//everything after the last finish is idle, so it is left out
+	CompareResult r;
+	vector<int> turnaround;
+	uint64_t sum = 0;
+	r.digest = 1469598103934665603ull;
+	auto mix = [&r](uint64_t value) {
+		for(int b = 0; b < 8; b++) {
+			r.digest = (r.digest ^ ((value >> (8 * b)) & 0xff)) * 1099511628211ull;
+		}
+	};
+	for(auto [arrival, completion] : scheduler.finishedCycles()) {
+		turnaround.push_back(completion - arrival);
+		sum += completion - arrival;
+		r.makespan = max(r.makespan, completion);
+		mix(arrival);
+		mix(completion);
+	}
+	sort(turnaround.begin(), turnaround.end());
+	r.finished = turnaround.size();
+	if(r.finished > 0) {
+		r.meanTurnaround = (double)sum / r.finished;
+		r.p99Turnaround = turnaround[(r.finished * 99 + 99) / 100 - 1];
+	}
+
+	CounterTotals t = scheduler.totals();
+	r.contextSwitches = t.contextSwitches;
+	r.instructions = t.instructions;
+	uint64_t capacity = (uint64_t)cfg.numcpu * r.makespan;
+	r.utilization = capacity ? 100.0 * t.busyTicks / capacity : 0.0;
+	return r;
+}
+
+/*
+ * runs every variant on its own thread and prints them side by side
+ *
+ * @param base - config every variant starts from
+ * @returns bool - false if a run was cancelled
+ * */
+bool runComparison(const Config& base, const vector<CompareVariant>& variants, uint64_t seed,
+	int processes, ostream& out) {
+	vector<optional<CompareResult>> results(variants.size());
+	vector<thread> runs;
+	for(size_t i = 0; i < variants.size(); i++) {
+		runs.emplace_back([&, i]() {
+			results[i] = runVariant(base, variants[i], seed, processes);
+		});
+	}
+	for(auto &run : runs) run.join();
+
+	out << "seed " << seed << ", " << processes << " processes, num_cpu " << base.numcpu
+		<< ", batch_process_freq " << base.batchFreq << ", delays_per_exec " << base.delayExec
+		<< ", min_ins " << base.minIns << ", max_ins " << base.maxIns << endl;
+	out << "times in cycles" << endl;
+	out << left << setw(12) << "variant" << right
+		<< setw(10) << "makespan" << setw(12) << "mean tat" << setw(10) << "p99 tat"
+		<< setw(8) << "util %" << setw(10) << "switches" << setw(14) << "instructions"
+		<< "  digest" << endl;
+
+	bool complete = true;
+	out << fixed;
+	for(size_t i = 0; i < variants.size(); i++) {
+		out << left << setw(12) << variants[i].label << right;
+		if(!results[i]) {
+			out << setw(10) << "cancelled" << endl;
+			complete = false;
+			continue;
+		}
+		const CompareResult& r = *results[i];
+		out << setw(10) << r.makespan
+			<< setw(12) << setprecision(1) << r.meanTurnaround
+			<< setw(10) << r.p99Turnaround
+			<< setw(8) << setprecision(1) << r.utilization
+			<< setw(10) << r.contextSwitches
+			<< setw(14) << r.instructions
+			<< "  " << hex << setw(16) << setfill('0') << r.digest << dec << setfill(' ') << endl;
+	}
+	out << defaultfloat;
+	return complete;
+}
+
+/*
+ * headless comparison, the config file is read like batch mode reads it
+ *
+ * @returns int - process exit code
+ * */
+int runCompare(const CompareOptions& opts) {
+	Config cfg;
+	if(!cfg.loadFile(opts.configPath))
+		return 1;
+	for(auto &[key, value] : opts.overrides) {
+		int error = cfg.set(key, value);
+		if(error != 0) {
+			Config::printError(error, key);
+			return 1;
+		}
+	}
+	if(int error = cfg.validate()) {
+		Config::printError(error, "");
+		return 1;
+	}
+
+	vector<CompareVariant> variants;
+	if(!parseVariants(opts.variants, cfg.quantumCycles, variants)) {
+		printCompareUsage();
+		return 2;
+	}
+	stringstream table;
+	bool complete = runComparison(cfg, variants, opts.seed, opts.processes, table);
+	if(opts.outPath == "-") {
+		cout << table.str();
+	} else {
+		ofstream out(opts.outPath, ios::trunc);
+		if(!out.is_open()) {
+			cerr << "[Error] Could not open " << opts.outPath << endl;
+			return 1;
+		}
+		out << table.str();
+	}
+	return complete ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include <csignal>
+
+/*
+ * console plumbing for the non-blocking CLI
+ *
+ * a dedicated thread reads stdin into commandQueue and the controller runs
+ * the queued commands one after another. everything written to the terminal
+ * goes through consoleMtx, so output of a command, of the config watcher
+ * and of the prompt never ends up inside each other's lines.
+ *
+ * "cancel" or Ctrl-C while a command is running stops its output at the
+ * next chunk; Ctrl-C at the prompt still ends the program.
+ * */
+mutex consoleMtx;
+atomic<bool> cancelRequested{false};
+atomic<bool> commandRunning{false};
+
+//writes a complete piece of output in one go
+void consoleWrite(const string& text) {
+	lock_guard<mutex> lock(consoleMtx);
+	cout << text << flush;
+}
+
+class CommandQueue {
+	deque<string> lines;
+	mutex mtx;
+	condition_variable cv;
+	bool closed = false;
+
+public:
+	void push(string line) {
+		{
+			lock_guard<mutex> lock(mtx);
+			lines.push_back(move(line));
+		}
+		cv.notify_one();
+	}
+
+	void close() {
+		{
+			lock_guard<mutex> lock(mtx);
+			closed = true;
+		}
+		cv.notify_all();
+	}
+
+	//blocks for the next line, false once closed and drained
+	bool pop(string& line) {
+		unique_lock<mutex> lock(mtx);
+		cv.wait(lock, [this]() { return !lines.empty() || closed; });
+		if(lines.empty()) return false;
+		line = move(lines.front());
+		lines.pop_front();
+		return true;
+	}
+
+	//like pop but gives up after timeout, for screens that refresh while waiting
+	bool popFor(string& line, chrono::milliseconds timeout) {
+		unique_lock<mutex> lock(mtx);
+		if(!cv.wait_for(lock, timeout, [this]() { return !lines.empty() || closed; }))
+			return false;
+		if(lines.empty()) return false;
+		line = move(lines.front());
+		lines.pop_front();
+		return true;
+	}
+};
+
+CommandQueue commandQueue;
+
+/*
+ * body of the input thread
+ *
+ * cancel is handled right here so it reaches a running command instead of
+ * waiting behind it in the queue. end of input turns into exit.
+ * */
+void readInput() {
+	string line;
+	while(getline(cin, line)) {
+		if(!line.empty() && line.back() == '\r') line.pop_back();
+		if(line == "cancel") {
+			if(commandRunning)
+				cancelRequested = true;
+			continue;
+		}
+		commandQueue.push(line);
+	}
+	commandQueue.push("exit");
+	commandQueue.close();
+}
+
+extern "C" void onInterrupt(int) {
+	if(!commandRunning) {
+		signal(SIGINT, SIG_DFL);
+		raise(SIGINT);
+		return;
+	}
+	cancelRequested = true;
+}
+
+/*
+ * streambuf behind the per-command output stream
+ *
+ * output is written under consoleMtx up to the last complete line once
+ * CHUNK bytes are buffered, so long listings stream out while they are
+ * generated without holding the console the whole time. after a cancel
+ * every write fails, which sets badbit on the stream so callers can stop.
+ * */
+class ConsoleBuf : public streambuf {
+	static constexpr size_t CHUNK = 4096;
+	string buffer;
+
+	bool drain(bool all) {
+		if(cancelRequested) {
+			buffer.clear();
+			return false;
+		}
+		size_t end = all ? buffer.size() : buffer.rfind('\n');
+		if(end == string::npos || end == 0) return true;
+		if(!all) end++;
+
+		lock_guard<mutex> lock(consoleMtx);
+		cout.write(buffer.data(), end);
+		cout.flush();
+		buffer.erase(0, end);
+		return true;
+	}
+
+protected:
+	int overflow(int c) override {
+		if(c == EOF) return 0;
+		buffer.push_back((char)c);
+		if(buffer.size() >= CHUNK && !drain(false)) return EOF;
+		return c;
+	}
+
+	streamsize xsputn(const char* s, streamsize n) override {
+		if(cancelRequested) return 0;
+		buffer.append(s, n);
+		if(buffer.size() >= CHUNK && !drain(false)) return 0;
+		return n;
+	}
+
+	int sync() override {
+		return drain(true) ? 0 : -1;
+	}
+};
+
+//output stream of one command
+class ConsoleStream : public ostream {
+	ConsoleBuf buf;
+
+public:
+	ConsoleStream() : ostream(&buf) {}
+	~ConsoleStream() { flush(); }
+};
@@ -0,0 +1,313 @@
+#include <list>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+/*
+ * local control endpoint on a unix domain socket
+ *
+ * one request per line, replies start with OK or ERR. multi-line replies
+ * end with a line holding only END.
+ *
+ *   SUBMIT <count> [prefix]            count generated processes
+ *   SUBMIT <count> [prefix] PROGRAM    count copies of the program on the
+ *   <instruction>...                   following lines, up to END, e.g.
+ *                                      READ disk 4096
+ *   END
+ *   STATUS                             one line of gauges
+ *   STATS                              counters and latency percentiles
+ *   TRACE ON|OFF
+ *   TRACE DUMP <file>
+ *   QUIT
+ *
+ * submitted processes are built on the connection's thread and handed to
+ * the scheduler in batches, so the ready queue lock is taken once per batch
+ * rather than once per process. SUBMIT replies OK <first pid> <admitted>
+ * <dropped>; past max_resident admission_policy drop rejects the rest and
+ * block or spill wait for room.
+ * */
+class ControlServer {
+	static constexpr size_t SUBMIT_BATCH = 1024;
+	static constexpr int MAX_SUBMIT = 1 << 20;
+
+	Scheduler& scheduler;
+	string path;
+	int listenFd;
+	atomic<bool> stop;
+	thread acceptThread;
+
+	//one thread per connection, finished ones are reaped by the accept loop
+	struct Client {
+		thread worker;
+		atomic<bool> done{false};
+	};
+	list<unique_ptr<Client>> clients;
+	atomic<uint64_t> submitted;
+
+#ifndef _WIN32
+	static bool sendAll(int fd, const string& text) {
+		size_t sent = 0;
+		while(sent < text.size()) {
+			ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+			if(n <= 0) return false;
+			sent += n;
+		}
+		return true;
+	}
+
+	/*
+	 * reads the next line of a connection
+	 *
+	 * @param buffer - bytes received but not consumed yet
+	 * @returns bool - false once the peer is gone or the server stops
+	 * */
+	bool readLine(int fd, string& buffer, string& line) {
+		while(true) {
+			size_t nl = buffer.find('\n');
+			if(nl != string::npos) {
+				line = buffer.substr(0, nl);
+				buffer.erase(0, nl + 1);
+				if(!line.empty() && line.back() == '\r') line.pop_back();
+				return true;
+			}
+			if(stop) return false;
+
+			pollfd pfd{fd, POLLIN, 0};
+			int ready = poll(&pfd, 1, 200);
+			if(ready < 0) return false;
+			if(ready == 0) continue;
+
+			char chunk[4096];
+			ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+			if(n <= 0) return false;
+			buffer.append(chunk, n);
+		}
+	}
+
+	//parses one program line, PRINT keeps the rest of the line as its message
+	static optional<Instruction> parseInstruction(const string& line) {
+		vector<string> tokens = tokenizeInput(line);
+		tokens.erase(remove(tokens.begin(), tokens.end(), ""), tokens.end());
+		if(tokens.empty()) return nullopt;
+
+		string op = tokens[0];
+		if(op == "PRINT") {
+			size_t start = line.find("PRINT") + 5;
+			string msg = start < line.size() ? line.substr(start + 1) : "";
+			return Instruction(op, {msg});
+		}
+		vector<string> args(tokens.begin() + 1, tokens.end());
+		if(op == "DECLARE" && args.size() == 2) return Instruction(op, args);
+		if((op == "ADD" || op == "SUBTRACT") && args.size() == 3) return Instruction(op, args);
+		if(op == "SLEEP" && args.size() == 1) return Instruction(op, args);
+		if((op == "READ" || op == "WRITE") && args.size() == 2) return Instruction(op, args);
+		return nullopt;
+	}
+
+	string submit(int fd, string& buffer, const vector<string>& req) {
+		int count = 0;
+		try { count = stoi(req[1]); } catch(...) { count = -1; }
+		if(count <= 0 || count > MAX_SUBMIT)
+			return "ERR count must be 1.." + to_string(MAX_SUBMIT) + "\n";
+
+		string prefix = req.size() >= 3 && req[2] != "PROGRAM" ? req[2] : "PROC-";
+		bool explicitProgram = req.back() == "PROGRAM";
+
+		vector<Instruction> program;
+		string bad;
+		if(explicitProgram) {
+			//always read up to END so the next request starts on a fresh line
+			string line;
+			while(true) {
+				if(!readLine(fd, buffer, line)) return "";
+				if(line == "END") break;
+				optional<Instruction> instr = parseInstruction(line);
+				if(instr)
+					program.push_back(*instr);
+				else if(bad.empty())
+					bad = line;
+			}
+			if(!bad.empty()) return "ERR bad instruction: " + bad + "\n";
+			if(program.empty()) return "ERR empty program\n";
+		}
+
+		int firstPid = -1;
+		int admitted = 0;
+		vector<unique_ptr<Process>> batch;
+		batch.reserve(min((size_t)count, SUBMIT_BATCH));
+		for(int i = 0; i < count; i++) {
+			unique_ptr<Process> p;
+			if(explicitProgram) {
+				int pid = nextId.fetch_add(1);
+				p = make_unique<Process>(pid, prefix + to_string(pid));
+				for(auto &instr : program) p->addInstruction(instr);
+			} else {
+				int pid = nextId.fetch_add(1);
+				p = buildRandomProcess(pid, prefix + to_string(pid));
+			}
+			if(firstPid < 0) firstPid = p->getPid();
+			batch.push_back(move(p));
+			if(batch.size() == SUBMIT_BATCH) {
+				admitted += scheduler.addProcesses(batch, stop);
+			}
+		}
+		if(!batch.empty())
+			admitted += scheduler.addProcesses(batch, stop);
+		submitted += admitted;
+		return "OK " + to_string(firstPid) + " " + to_string(admitted) + " " + to_string(count - admitted) + "\n";
+	}
+
+	string status() {
+		AdmissionStats a = scheduler.admissionStats();
+		CounterTotals t = scheduler.totals();
+		stringstream ss;
+		ss << "OK cycle=" << scheduler.getCycle()
+			<< " cores=" << scheduler.getCoreCount()
+			<< " ready=" << a.ready
+			<< " sleeping=" << a.sleeping
+			<< " io_wait=" << a.ioWaiting
+			<< " resident=" << a.resident
+			<< " finished=" << scheduler.getFinishedCount()
+			<< " spilled=" << a.spillDepth
+			<< " dropped=" << a.dropped
+			<< " instructions=" << t.instructions << "\n";
+		return ss.str();
+	}
+
+	string stats() {
+		CounterTotals t = scheduler.totals();
+		stringstream ss;
+		ss << "OK\n";
+		ss << "instructions " << t.instructions << "\n"
+			<< "busy_ticks " << t.busyTicks << "\n"
+			<< "idle_ticks " << t.idleTicks << "\n"
+			<< "context_switches " << t.contextSwitches << "\n"
+			<< "quantum_expiries " << t.quantumExpiries << "\n"
+			<< "migrations " << t.migrations << "\n"
+			<< "utilization_pct " << t.utilization() << "\n";
+		ss << scheduler.latencySummary(false);
+		ss << "END\n";
+		return ss.str();
+	}
+
+	string handle(int fd, string& buffer, const string& line) {
+		vector<string> req = tokenizeInput(line);
+		req.erase(remove(req.begin(), req.end(), ""), req.end());
+		if(req.empty()) return "";
+
+		if(req[0] == "SUBMIT" && req.size() >= 2)
+			return submit(fd, buffer, req);
+		if(req[0] == "STATUS")
+			return status();
+		if(req[0] == "STATS")
+			return stats();
+		if(req[0] == "TRACE" && req.size() >= 2) {
+			if(req[1] == "ON" || req[1] == "OFF") {
+				scheduler.setTracing(req[1] == "ON");
+				return "OK\n";
+			}
+			if(req[1] == "DUMP" && req.size() >= 3)
+				return scheduler.dumpTrace(req[2]) ? "OK\n" : "ERR nothing traced\n";
+		}
+		return "ERR unknown request\n";
+	}
+
+	void serve(int fd) {
+		string buffer, line;
+		while(readLine(fd, buffer, line)) {
+			if(line == "QUIT") break;
+			string reply = handle(fd, buffer, line);
+			if(reply.empty() && stop) break;
+			if(!reply.empty() && !sendAll(fd, reply)) break;
+		}
+		close(fd);
+	}
+#endif
+
+public:
+	explicit ControlServer(Scheduler& scheduler_) :
+		scheduler(scheduler_),
+		listenFd(-1),
+		stop(false),
+		submitted(0)
+	{}
+
+	~ControlServer() { shutdown(); }
+
+	/*
+	 * @param path_ - socket file, replaced if it already exists
+	 * @returns bool - false if the socket could not be bound
+	 * */
+	bool start(const string& path_) {
+#ifndef _WIN32
+		shutdown();
+		path = path_;
+		sockaddr_un addr{};
+		if(path.size() >= sizeof(addr.sun_path)) return false;
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+		listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(listenFd < 0) return false;
+		unlink(path.c_str());
+		if(bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+			close(listenFd);
+			listenFd = -1;
+			return false;
+		}
+
+		stop = false;
+		acceptThread = thread([this]() {
+			while(!stop) {
+				pollfd pfd{listenFd, POLLIN, 0};
+				if(poll(&pfd, 1, 200) <= 0) continue;
+				int fd = accept(listenFd, nullptr, nullptr);
+				if(fd < 0) continue;
+
+				clients.remove_if([](unique_ptr<Client>& c) {
+					if(!c->done) return false;
+					c->worker.join();
+					return true;
+				});
+				clients.push_back(make_unique<Client>());
+				Client* client = clients.back().get();
+				client->worker = thread([this, fd, client]() {
+					serve(fd);
+					client->done = true;
+				});
+			}
+		});
+		return true;
+#else
+		(void)path_;
+		return false;
+#endif
+	}
+
+	void shutdown() {
+#ifndef _WIN32
+		if(listenFd < 0) return;
+		stop = true;
+		if(acceptThread.joinable())
+			acceptThread.join();
+		for(auto &client : clients) {
+			client->worker.join();
+		}
+		clients.clear();
+		close(listenFd);
+		listenFd = -1;
+		unlink(path.c_str());
+#endif
+	}
+
+	bool isRunning() const { return listenFd >= 0; }
+	const string& getPath() const { return path; }
+	uint64_t getSubmitted() const { return submitted; }
+};
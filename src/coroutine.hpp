@@ -0,0 +1,80 @@
+/*
+ * coroutine execution backend
+ *
+ * with exec_backend coroutine every process runs as a C++20 coroutine that a
+ * core resumes for a slice. the coroutine suspends itself when the quantum
+ * runs out, when it hits SLEEP or READ/WRITE (the process then waits in the
+ * sleeping queue or on its device instead of holding a core) and between instructions when the core has to
+ * pace itself with delays_per_exec. only available when built with -std=c++20.
+ * */
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#include <utility>
+#define CSOPESY_COROUTINES 1
+
+enum class Suspend {
+	Tick,		// paused between instructions, stays on the core
+	Preempt,	// quantum expired
+	Sleep,		// blocked on SLEEP, leaves the core
+	Io,			// blocked on READ or WRITE, leaves the core
+	Done
+};
+
+//what the core hands to the coroutine on every resume
+struct ExecContext {
+	LogCursor* log = nullptr;
+	int budget = 0;		// instructions left in the quantum
+	int steps = 0;		// instructions before the next Tick
+	int executed = 0;	// instructions run during this resume
+};
+
+class ProcessTask {
+public:
+	struct promise_type {
+		Suspend reason = Suspend::Tick;
+
+		ProcessTask get_return_object() {
+			return ProcessTask(coroutine_handle<promise_type>::from_promise(*this));
+		}
+		suspend_always initial_suspend() noexcept { return {}; }
+		suspend_always final_suspend() noexcept { return {}; }
+		void return_void() { reason = Suspend::Done; }
+		void unhandled_exception() { terminate(); }
+	};
+
+	//co_await ProcessTask::pause(reason) hands control back to the core
+	struct Pause {
+		Suspend reason;
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(coroutine_handle<promise_type> h) noexcept { h.promise().reason = reason; }
+		void await_resume() const noexcept {}
+	};
+
+private:
+	coroutine_handle<promise_type> handle;
+
+public:
+	ProcessTask() = default;
+	explicit ProcessTask(coroutine_handle<promise_type> h) : handle(h) {}
+	ProcessTask(ProcessTask&& o) noexcept : handle(exchange(o.handle, nullptr)) {}
+	ProcessTask& operator=(ProcessTask&& o) noexcept {
+		if(this != &o) {
+			if(handle) handle.destroy();
+			handle = exchange(o.handle, nullptr);
+		}
+		return *this;
+	}
+	ProcessTask(const ProcessTask&) = delete;
+	~ProcessTask() { if(handle) handle.destroy(); }
+
+	explicit operator bool() const { return static_cast<bool>(handle); }
+
+	//runs until the next suspension point
+	Suspend resume() {
+		if(!handle || handle.done()) return Suspend::Done;
+		handle.resume();
+		return handle.done() ? Suspend::Done : handle.promise().reason;
+	}
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include <cstdint>
+
+using SteadyClock = chrono::steady_clock;
+
+inline uint64_t elapsedNs(SteadyClock::time_point since) {
+	return chrono::duration_cast<chrono::nanoseconds>(SteadyClock::now() - since).count();
+}
+
+/*
+ * hot path counters of a single core
+ *
+ * every field is only ever written by the core that owns it, so an update is
+ * a relaxed load and store rather than a locked add. the struct is padded to
+ * its own cache lines so neighbouring cores never share one.
+ * */
+struct alignas(64) CoreCounters {
+	atomic<uint64_t> instructions{0};
+	atomic<uint64_t> busyTicks{0};
+	atomic<uint64_t> idleTicks{0};
+	atomic<uint64_t> contextSwitches{0};
+	atomic<uint64_t> quantumExpiries{0};
+	atomic<uint64_t> sleeps{0};
+	atomic<uint64_t> lockWaitNs{0};
+	atomic<uint64_t> switchNs{0};
+	atomic<uint64_t> busyNs{0};
+	atomic<uint64_t> idleNs{0};
+	atomic<uint64_t> migrations{0};
+	atomic<uint64_t> migrationStalls{0};
+
+	static void add(atomic<uint64_t>& counter, uint64_t n = 1) {
+		counter.store(counter.load(memory_order_relaxed) + n, memory_order_relaxed);
+	}
+};
+
+/*
+ * plain copy of one or more CoreCounters taken at a point in time
+ * */
+struct CounterTotals {
+	uint64_t instructions = 0;
+	uint64_t busyTicks = 0;
+	uint64_t idleTicks = 0;
+	uint64_t contextSwitches = 0;
+	uint64_t quantumExpiries = 0;
+	uint64_t sleeps = 0;
+	uint64_t lockWaitNs = 0;
+	uint64_t switchNs = 0;
+	uint64_t busyNs = 0;
+	uint64_t idleNs = 0;
+	uint64_t migrations = 0;
+	uint64_t migrationStalls = 0;
+	SteadyClock::time_point at = SteadyClock::now();
+
+	void add(const CoreCounters& c) {
+		instructions += c.instructions.load(memory_order_relaxed);
+		busyTicks += c.busyTicks.load(memory_order_relaxed);
+		idleTicks += c.idleTicks.load(memory_order_relaxed);
+		contextSwitches += c.contextSwitches.load(memory_order_relaxed);
+		quantumExpiries += c.quantumExpiries.load(memory_order_relaxed);
+		sleeps += c.sleeps.load(memory_order_relaxed);
+		lockWaitNs += c.lockWaitNs.load(memory_order_relaxed);
+		switchNs += c.switchNs.load(memory_order_relaxed);
+		busyNs += c.busyNs.load(memory_order_relaxed);
+		idleNs += c.idleNs.load(memory_order_relaxed);
+		migrations += c.migrations.load(memory_order_relaxed);
+		migrationStalls += c.migrationStalls.load(memory_order_relaxed);
+	}
+
+	//difference between two snapshots of the same counters
+	CounterTotals operator-(const CounterTotals& o) const {
+		CounterTotals d;
+		d.instructions = instructions - o.instructions;
+		d.busyTicks = busyTicks - o.busyTicks;
+		d.idleTicks = idleTicks - o.idleTicks;
+		d.contextSwitches = contextSwitches - o.contextSwitches;
+		d.quantumExpiries = quantumExpiries - o.quantumExpiries;
+		d.sleeps = sleeps - o.sleeps;
+		d.lockWaitNs = lockWaitNs - o.lockWaitNs;
+		d.switchNs = switchNs - o.switchNs;
+		d.busyNs = busyNs - o.busyNs;
+		d.idleNs = idleNs - o.idleNs;
+		d.migrations = migrations - o.migrations;
+		d.migrationStalls = migrationStalls - o.migrationStalls;
+		d.at = at;
+		return d;
+	}
+
+	double seconds(const CounterTotals& since) const {
+		return chrono::duration<double>(at - since.at).count();
+	}
+
+	//share of measured core time spent holding a process, of core cycles in lockstep
+	double utilization() const {
+		uint64_t total = busyNs + idleNs;
+		if(total == 0) {
+			total = busyTicks + idleTicks;
+			return total ? 100.0 * busyTicks / total : 0.0;
+		}
+		return 100.0 * busyNs / total;
+	}
+};
@@ -1,6 +1,8 @@
 #pragma once
 #include <atomic>
+#include <cstdint>
 
 std::atomic<int> nextId{0};
 int minIns = 5;
 int maxIns = 10;
+uint64_t workloadSeed = 0;	// generated programs are a function of this and the pid
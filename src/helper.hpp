@@ -31,6 +31,36 @@ vector<string> tokenizeInput(string input)
 	return tokens;
 }
 
+/*
+ * splitmix64, the generator behind every random program
+ *
+ * seeded per process from the workload seed and the pid, so a program does
+ * not depend on which thread builds it or on what was generated before it
+ * */
+struct WorkloadRng {
+	uint64_t state;
+
+	WorkloadRng(uint64_t seed, int pid) :
+		state(seed ^ (0x9E3779B97F4A7C15ull * (uint64_t)(pid + 1)))
+	{}
+
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	//uniform enough for the small ranges used here
+	int below(int n) { return next() % n; }
+};
+
+//share of READ and WRITE in generated programs and the devices they go to
+struct IoMix {
+	int percent = 0;
+	vector<string> devices;
+};
+
 vector<Instruction> processForLoop(int loopCount) {
    vector<Instruction> loopInstructions;
 
@@ -49,15 +79,23 @@ vector<Instruction> processForLoop(int loopCount) {
    return loopInstructions;
 }
 
-vector<Instruction> generateRandomInstruction() {
+vector<Instruction> generateRandomInstruction(WorkloadRng& rng, const IoMix& io) {
+	//no draw without devices, so seeds keep their programs when io_mix is 0
+	if (io.percent > 0 && rng.below(100) < io.percent) {
+		string op = rng.below(2) == 0 ? "READ" : "WRITE";
+		string device = io.devices[rng.below(io.devices.size())];
+		string bytes = to_string(512 << rng.below(8));
+		return {Instruction(op, {device, bytes})};
+	}
+
 	static vector<string> ops = {"DECLARE", "ADD", "SUBTRACT", "PRINT", "SLEEP", "FOR"};
-   string op = ops[rand() % ops.size()];
+   string op = ops[rng.below(ops.size())];
    vector<string> args;
 
-   string var1 = "VAR" + to_string(rand() % 3);
-   string var2 = "VAR" + to_string(rand() % 3);
-   string var3 = "VAR" + to_string(rand() % 3);
-   string literal = to_string(rand() % 50 + 1); 
+   string var1 = "VAR" + to_string(rng.below(3));
+   string var2 = "VAR" + to_string(rng.below(3));
+   string var3 = "VAR" + to_string(rng.below(3));
+   string literal = to_string(rng.below(50) + 1); 
 
 	vector<Instruction> instructions;
 
@@ -67,13 +105,13 @@ vector<Instruction> generateRandomInstruction() {
 	} else if (op == "ADD" || op == "SUBTRACT") {
    	args.push_back(var1); 
       args.push_back(var2); 
-      args.push_back((rand() % 2 == 0) ? var3 : literal); 
+      args.push_back((rng.below(2) == 0) ? var3 : literal); 
    } else if (op == "PRINT") {
       args.push_back("Hello World!");
 //   } else if (op == "SLEEP") {
 //      args.push_back(to_string(rand() % 3 + 1)); 
    } else if (op == "FOR") {
-		int loopCount = rand() % 3 + 1;
+		int loopCount = rng.below(3) + 1;
 		instructions = processForLoop(loopCount);
 		return instructions;
 	}
@@ -84,19 +122,22 @@ vector<Instruction> generateRandomInstruction() {
 }
 
 
-//basic random process generator 
-unique_ptr<Process> createRandomProcess(string name = "PROC-") {
-	//setup name and id
-	int pid = nextId.fetch_add(1);
-	if(name == "PROC-")
-		name += to_string(pid);
+/*
+ * builds a random program for an already assigned pid
+ *
+ * @param seed - workload seed, the same seed and pid give the same program
+ * @param lo, hi - instruction count range
+ * @param io - how much of the program is READ and WRITE
+ * */
+unique_ptr<Process> buildRandomProcess(int pid, string name, uint64_t seed = workloadSeed,
+	int lo = minIns, int hi = maxIns, const IoMix& io = IoMix()) {
 	auto p = make_unique<Process>(pid, name);
 
-	srand(time(nullptr) + pid);
-	int len = rand() % (maxIns - minIns + 1) + minIns; 
+	WorkloadRng rng(seed, pid);
+	int len = rng.below(hi - lo + 1) + lo; 
 
 	for(int i = 0; i < len; i++) {
-		vector<Instruction> instr = generateRandomInstruction();
+		vector<Instruction> instr = generateRandomInstruction(rng, io);
 		for(auto& i : instr) {
 			p->addInstruction(i);
 		}
@@ -108,3 +149,12 @@ unique_ptr<Process> createRandomProcess(string name = "PROC-") {
 	//returns the newly made process
 	return p;
 }
+
+//basic random process generator 
+unique_ptr<Process> createRandomProcess(string name = "PROC-") {
+	//setup name and id
+	int pid = nextId.fetch_add(1);
+	if(name == "PROC-")
+		name += to_string(pid);
+	return buildRandomProcess(pid, name);
+}
@@ -2,6 +2,49 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+
+// one simulated device of io_devices, name:latency_cycles:bytes_per_cycle
+struct IoDeviceSpec
+{
+    std::string name;
+    long long int latency;
+    long long int bandwidth;
+};
+
+/*
+ * parses io_devices, e.g. disk:50:512,net:200:64
+ *
+ * @returns bool - false unless every entry has a unique name, a latency of
+ *                 0 to 1000000 cycles and a bandwidth of at least 1 byte per cycle
+ * */
+bool parseIoDevices(const std::string& value, std::vector<IoDeviceSpec>& devices)
+{
+    std::istringstream list(value);
+    std::string entry;
+    while (getline(list, entry, ','))
+    {
+        size_t a = entry.find(':');
+        size_t b = a == std::string::npos ? a : entry.find(':', a + 1);
+        if (a == 0 || b == std::string::npos)
+            return false;
+        try
+        {
+            IoDeviceSpec spec{entry.substr(0, a), std::stoll(entry.substr(a + 1, b - a - 1)), std::stoll(entry.substr(b + 1))};
+            if (spec.latency < 0 || spec.latency > 1000000 || spec.bandwidth < 1 || spec.bandwidth > 1LL << 31)
+                return false;
+            for (auto &other : devices)
+                if (other.name == spec.name)
+                    return false;
+            devices.push_back(spec);
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+    return !devices.empty();
+}
 
 struct Config
 {
@@ -13,38 +56,116 @@ struct Config
     long long int maxIns;
     long long int delayExec;
 
-    bool loadFile();
-    void print() const;
+    //optional keys
+    std::string execModel = "threads";
+    std::string execBackend = "step";
+    long long int execWorkers = 0;
+    long long int migrationCost = 0;
+    long long int maxResident = 0;
+    std::string admissionPolicy = "block";
+    std::string controlSocket;
+    std::string metricsFile;
+    long long int metricsInterval = 5000;
+    std::string cpuAffinity = "none";
+    std::string cpuList;
+    std::string clockMode = "wall";
+    long long int cycleUs = 0;
+    long long int seed = -1;
+    std::string ioDevices;
+    long long int ioMix = 0;
+    std::string clusterName;
+    std::string clusterListen;
+    std::string clusterPeers;
+    long long int clusterInterval = 500;
+
+    bool loadFile(const std::string& path = "config.txt");
+    bool load(std::istream& in);
+    int set(const std::string& key, const std::string& value);
+    static void printError(int error, const std::string& key);
+    int validate() const;
+    void print(std::ostream& out = std::cout) const;
 };
 
-bool Config::loadFile()
+bool Config::loadFile(const std::string& path)
 {
     std::ifstream file;
-    file.open("config.txt");
+    file.open(path);
 	 if (!file.is_open()) {
-        std::cerr << "[Error] Could not open config.txt" << std::endl;
+        std::cerr << "[Error] Could not open " << path << std::endl;
         return false;
     }
+    return load(file);
+}
 
-
+// one "key value" pair per line, as in config.txt
+bool Config::load(std::istream& in)
+{
     std::string text;
 
-    int error = 0;
-    while (getline(file, text))
+    while (getline(in, text))
     {
         if (text.empty())
             continue;
 
-        if (error != 0)
-            continue;
         std::istringstream iss(text);
         std::string key, value;
         iss >> key >> value;
 
+        if (key.empty())
+            continue;
+
+        int error = set(key, value);
+        if (error != 0)
+        {
+            printError(error, key);
+            return false;
+        }
+    }
+
+    int error = validate();
+    if (error != 0)
+    {
+        printError(error, "");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * checks rules that span more than one key
+ *
+ * @returns int - 0 if the combination is valid, otherwise the error code
+ * */
+int Config::validate() const
+{
+    // a thread per core only scales to 128 cores, the pool goes further
+    if (execModel == "threads" && numcpu > 128)
+        return 13;
+#ifndef CSOPESY_COROUTINES
+    if (execBackend == "coroutine")
+        return 15;
+#endif
+    if (cpuAffinity == "list" && cpuList.empty())
+        return 18;
+    if (ioMix > 0 && ioDevices.empty())
+        return 28;
+    return 0;
+}
+
+/*
+ * validates and applies a single config key
+ *
+ * @returns int - 0 on success, otherwise the error code for printError
+ * */
+int Config::set(const std::string& key, const std::string& value)
+{
+    int error = 0;
+    try
+    {
         if (key == "num_cpu")
         {
             int val = std::stoi(value);
-            if (val >= 1 && val <= 128)
+            if (val >= 1 && val <= 16384)
                 numcpu = val;
             else
                 error = 1;
@@ -99,54 +220,268 @@ bool Config::loadFile()
             else
                 error = 8;
         }
-        else
+        else if (key == "exec_model")
         {
-            std::cerr << "[Error] Unknown key: " << key << std::endl;
-            return false;
+            if (value == "threads" || value == "pool")
+                execModel = value;
+            else
+                error = 11;
         }
-
-        if (error != 0)
+        else if (key == "exec_backend")
         {
-            switch (error)
-            {
-            case 1:
-                std::cerr << "[Error] num_cpu out of range" << std::endl;
-                break;
-            case 2:
-                std::cerr << "[Error] scheduler is not either rr or fcfs" << std::endl;
-                break;
-            case 3:
-                std::cerr << "[Error] quantum_cycles out of range" << std::endl;
-                break;
-            case 4:
-                std::cerr << "[Error] batch_process_freq out of range" << std::endl;
-                break;
-            case 5:
-                std::cerr << "[Error] min_ins out of range" << std::endl;
-                break;
-            case 6:
-                std::cerr << "[Error] min_ins greater than max_ins" << std::endl;
-                break;
-            case 7:
-                std::cerr << "[Error] max_ins out of range" << std::endl;
-                break;
-            case 8:
-                std::cerr << "[Error] delays_per_exec out of range" << std::endl;
-                break;
-            }
-            return false;
+            if (value == "step" || value == "coroutine")
+                execBackend = value;
+            else
+                error = 14;
+        }
+        else if (key == "exec_workers")
+        {
+            long long int val = std::stoll(value);
+            if (val >= 0 && val <= 4096)
+                execWorkers = val;
+            else
+                error = 12;
+        }
+        else if (key == "migration_cost")
+        {
+            long long int val = std::stoll(value);
+            if (val >= 0 && val <= 1 << 16)
+                migrationCost = val;
+            else
+                error = 19;
+        }
+        else if (key == "max_resident")
+        {
+            // 0 admits everything
+            long long int val = std::stoll(value);
+            if (val >= 0 && val <= 1LL << 32)
+                maxResident = val;
+            else
+                error = 20;
+        }
+        else if (key == "admission_policy")
+        {
+            if (value == "block" || value == "drop" || value == "spill")
+                admissionPolicy = value;
+            else
+                error = 21;
+        }
+        else if (key == "control_socket")
+        {
+            // started at initialize when set
+            controlSocket = value;
+        }
+        else if (key == "clock_mode")
+        {
+            // lockstep counts quantum, delay and sleep in barrier cycles
+            if (value == "wall" || value == "lockstep")
+                clockMode = value;
+            else
+                error = 23;
+        }
+        else if (key == "cycle_us")
+        {
+            // lockstep pacing, 0 runs cycles back to back
+            long long int val = std::stoll(value);
+            if (val >= 0 && val <= 10000000)
+                cycleUs = val;
+            else
+                error = 24;
+        }
+        else if (key == "seed")
+        {
+            // workload seed, -1 picks one from the clock
+            long long int val = std::stoll(value);
+            if (val >= -1)
+                seed = val;
+            else
+                error = 25;
+        }
+        else if (key == "io_devices")
+        {
+            std::vector<IoDeviceSpec> devices;
+            if (parseIoDevices(value, devices))
+                ioDevices = value;
+            else
+                error = 26;
+        }
+        else if (key == "io_mix")
+        {
+            // percent of generated instructions that are READ or WRITE
+            long long int val = std::stoll(value);
+            if (val >= 0 && val <= 100)
+                ioMix = val;
+            else
+                error = 27;
+        }
+        else if (key == "cluster_name")
+        {
+            // defaults to node-<pid>
+            clusterName = value;
+        }
+        else if (key == "cluster_listen")
+        {
+            // unix:<path>, a path or host:port, cluster mode starts at initialize when set
+            clusterListen = value;
+        }
+        else if (key == "cluster_peers")
+        {
+            // comma separated addresses of the other nodes
+            clusterPeers = value;
+        }
+        else if (key == "cluster_interval_ms")
+        {
+            long long int val = std::stoll(value);
+            if (val >= 50 && val <= 60000)
+                clusterInterval = val;
+            else
+                error = 29;
+        }
+        else if (key == "metrics_file")
+        {
+            // prometheus textfile, written from initialize on when set
+            metricsFile = value;
+        }
+        else if (key == "metrics_interval_ms")
+        {
+            long long int val = std::stoll(value);
+            // the exporter waits on an int of milliseconds
+            if (val >= 100 && val <= std::numeric_limits<int>::max())
+                metricsInterval = val;
+            else
+                error = 22;
+        }
+        else if (key == "cpu_affinity")
+        {
+            if (value == "none" || value == "compact" || value == "scatter" || value == "list")
+                cpuAffinity = value;
+            else
+                error = 16;
+        }
+        else if (key == "cpu_list")
+        {
+            // e.g. 0,2,4-7
+            if (!value.empty() && value.find_first_not_of("0123456789,-") == std::string::npos)
+                cpuList = value;
+            else
+                error = 17;
+        }
+        else
+        {
+            error = 9;
         }
     }
-    return true;
+    catch (...)
+    {
+        error = 10;
+    }
+    return error;
+}
+
+void Config::printError(int error, const std::string& key)
+{
+    switch (error)
+    {
+    case 1:
+        std::cerr << "[Error] num_cpu out of range" << std::endl;
+        break;
+    case 2:
+        std::cerr << "[Error] scheduler is not either rr or fcfs" << std::endl;
+        break;
+    case 3:
+        std::cerr << "[Error] quantum_cycles out of range" << std::endl;
+        break;
+    case 4:
+        std::cerr << "[Error] batch_process_freq out of range" << std::endl;
+        break;
+    case 5:
+        std::cerr << "[Error] min_ins out of range" << std::endl;
+        break;
+    case 6:
+        std::cerr << "[Error] min_ins greater than max_ins" << std::endl;
+        break;
+    case 7:
+        std::cerr << "[Error] max_ins out of range" << std::endl;
+        break;
+    case 8:
+        std::cerr << "[Error] delays_per_exec out of range" << std::endl;
+        break;
+    case 9:
+        std::cerr << "[Error] Unknown key: " << key << std::endl;
+        break;
+    case 10:
+        std::cerr << "[Error] Invalid value for " << key << std::endl;
+        break;
+    case 11:
+        std::cerr << "[Error] exec_model is not either threads or pool" << std::endl;
+        break;
+    case 12:
+        std::cerr << "[Error] exec_workers out of range" << std::endl;
+        break;
+    case 13:
+        std::cerr << "[Error] num_cpu above 128 needs exec_model pool" << std::endl;
+        break;
+    case 14:
+        std::cerr << "[Error] exec_backend is not either step or coroutine" << std::endl;
+        break;
+    case 15:
+        std::cerr << "[Error] exec_backend coroutine needs a -std=c++20 build" << std::endl;
+        break;
+    case 16:
+        std::cerr << "[Error] cpu_affinity is not one of none, compact, scatter or list" << std::endl;
+        break;
+    case 17:
+        std::cerr << "[Error] cpu_list is not a list like 0,2,4-7" << std::endl;
+        break;
+    case 18:
+        std::cerr << "[Error] cpu_affinity list needs cpu_list" << std::endl;
+        break;
+    case 19:
+        std::cerr << "[Error] migration_cost out of range" << std::endl;
+        break;
+    case 20:
+        std::cerr << "[Error] max_resident out of range" << std::endl;
+        break;
+    case 21:
+        std::cerr << "[Error] admission_policy is not one of block, drop or spill" << std::endl;
+        break;
+    case 22:
+        std::cerr << "[Error] metrics_interval_ms out of range" << std::endl;
+        break;
+    case 23:
+        std::cerr << "[Error] clock_mode is not either wall or lockstep" << std::endl;
+        break;
+    case 24:
+        std::cerr << "[Error] cycle_us out of range" << std::endl;
+        break;
+    case 25:
+        std::cerr << "[Error] seed is negative" << std::endl;
+        break;
+    case 26:
+        std::cerr << "[Error] io_devices is not a list like disk:50:512,net:200:64" << std::endl;
+        break;
+    case 27:
+        std::cerr << "[Error] io_mix is not a percentage" << std::endl;
+        break;
+    case 28:
+        std::cerr << "[Error] io_mix needs io_devices" << std::endl;
+        break;
+    case 29:
+        std::cerr << "[Error] cluster_interval_ms out of range" << std::endl;
+        break;
+    }
 }
 
-void Config::print() const
+void Config::print(std::ostream& out) const
 {
-    std::cout << "numcpu: " << numcpu << "\n";
-    std::cout << "scheduler: " << scheduler << "\n";
-    std::cout << "quantumCycles: " << quantumCycles << "\n";
-    std::cout << "batchFreq: " << batchFreq << "\n";
-    std::cout << "minIns: " << minIns << "\n";
-    std::cout << "maxIns: " << maxIns << "\n";
-    std::cout << "delayExec: " << delayExec << "\n\n";
+    out << "numcpu: " << numcpu << "\n";
+    out << "scheduler: " << scheduler << "\n";
+    out << "quantumCycles: " << quantumCycles << "\n";
+    out << "batchFreq: " << batchFreq << "\n";
+    out << "minIns: " << minIns << "\n";
+    out << "maxIns: " << maxIns << "\n";
+    out << "delayExec: " << delayExec << "\n";
+    out << "execModel: " << execModel << "\n";
+    out << "clockMode: " << clockMode << "\n";
+    out << "cpuAffinity: " << cpuAffinity << "\n\n";
 }
@@ -1,23 +1,76 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <map>        // For variable memory
+#include <map>
+#include <cstdint>
 #include <sstream>    // For string manipulation
 
+// how programs are written and read back, a process stores them packed
 struct Instruction {
     string operation;
     vector<string> arguments;
-	bool output;
+	uint32_t msgId = 0;	// interned PRINT message, set by Process::addInstruction
 
     Instruction() = default;
     Instruction(const string& op, const vector<string>& args = {})
         : operation(op), arguments(args) {}
 
+    // the PRINT message, interned once when the instruction is added
     string getOutput() const {
-        stringstream ss;
+        string out;
         for (const auto& arg : arguments) {
-            ss << " " << arg;
+            out += ' ';
+            out += arg;
         }
-        return ss.str();
+        return out;
     }
 };
+
+enum OpCode : uint8_t {
+	OP_NOP,			// FOR markers, unknown operations and ones missing arguments
+	OP_DECLARE,
+	OP_ADD,
+	OP_SUBTRACT,
+	OP_PRINT,
+	OP_SLEEP,
+	OP_READ,
+	OP_WRITE
+};
+
+//operand kinds, a set bit means the operand is a variable slot, otherwise an immediate
+constexpr uint8_t KIND_A_SLOT = 1;
+constexpr uint8_t KIND_B_SLOT = 2;
+
+/*
+ * one instruction of a packed program
+ *
+ * dst is a variable slot of the process. a and b are slots or immediates as
+ * kinds says, except that PRINT keeps its message id in a, READ and WRITE
+ * their device's slot, and NOP the slot holding the operation's name.
+ * */
+struct PackedInstruction {
+	uint8_t op;
+	uint8_t kinds;
+	uint16_t pad;
+	int32_t dst;
+	int32_t a;
+	int32_t b;
+};
+static_assert(sizeof(PackedInstruction) == 16, "packed instructions must stay 16 bytes");
+
+/*
+ * @returns bool - true if text is an integer written the way to_string writes it,
+ *                 only those become immediates so the program decodes unchanged
+ * */
+bool parseImmediate(const string& text, int32_t& value) {
+	if(text.empty() || text.size() > 11) return false;
+	try {
+		size_t used;
+		long long v = stoll(text, &used);
+		if(used != text.size() || v < INT32_MIN || v > INT32_MAX || to_string(v) != text) return false;
+		value = v;
+		return true;
+	} catch(...) {
+		return false;
+	}
+}
@@ -0,0 +1,96 @@
+#include <string_view>
+#include <unordered_map>
+#include <array>
+#include <memory>
+
+/*
+ * append-only table of PRINT messages and process names
+ *
+ * every distinct string is stored once and named by a 32-bit id, so
+ * instructions, log records and processes carry ids and compare them as
+ * integers; the text is only looked up when something is printed.
+ *
+ * interning locks one of SHARDS hash shards, so threads building processes
+ * rarely meet. strings live in chunks that never move and are never changed
+ * once their id is handed out, so lookup takes no lock.
+ * */
+class StringInterner {
+	static constexpr size_t CHUNK = 4096;
+	static constexpr size_t MAX_CHUNKS = 1 << 16;
+	static constexpr size_t SHARDS = 16;
+
+	struct alignas(64) Shard {
+		mutex mtx;
+		unordered_map<string_view, uint32_t> ids;	// views into the chunks
+	};
+
+	array<Shard, SHARDS> shards;
+	unique_ptr<atomic<string*>[]> chunks;
+	atomic<uint32_t> count;
+	mutex growMtx;
+
+	string* slot(uint32_t id) {
+		atomic<string*>& entry = chunks[id / CHUNK];
+		string* chunk = entry.load(memory_order_acquire);
+		if(!chunk) {
+			lock_guard<mutex> lock(growMtx);
+			chunk = entry.load(memory_order_relaxed);
+			if(!chunk) {
+				chunk = new string[CHUNK];
+				entry.store(chunk, memory_order_release);
+			}
+		}
+		return chunk + id % CHUNK;
+	}
+
+	Shard& shardOf(string_view str) {
+		return shards[hash<string_view>()(str) % SHARDS];
+	}
+
+public:
+	StringInterner() :
+		chunks(new atomic<string*>[MAX_CHUNKS]),
+		count(0)
+	{
+		for(size_t i = 0; i < MAX_CHUNKS; i++) chunks[i] = nullptr;
+	}
+
+	~StringInterner() {
+		for(size_t i = 0; i < MAX_CHUNKS; i++) delete[] chunks[i].load();
+	}
+
+	uint32_t intern(string_view str) {
+		Shard& shard = shardOf(str);
+		lock_guard<mutex> lock(shard.mtx);
+		auto it = shard.ids.find(str);
+		if(it != shard.ids.end()) return it->second;
+
+		uint32_t id = count.fetch_add(1, memory_order_relaxed);
+		string* stored = slot(id);
+		stored->assign(str.data(), str.size());
+		shard.ids.emplace(string_view(*stored), id);
+		return id;
+	}
+
+	//looks a string up without adding it, for names typed by the user
+	bool find(string_view str, uint32_t& id) {
+		Shard& shard = shardOf(str);
+		lock_guard<mutex> lock(shard.mtx);
+		auto it = shard.ids.find(str);
+		if(it == shard.ids.end()) return false;
+		id = it->second;
+		return true;
+	}
+
+	//the string behind an id intern returned, empty for any other id
+	const string& lookup(uint32_t id) const {
+		static const string none;
+		if(id >= count.load(memory_order_acquire)) return none;
+		string* chunk = chunks[id / CHUNK].load(memory_order_acquire);
+		return chunk ? chunk[id % CHUNK] : none;
+	}
+
+	size_t size() const { return count.load(memory_order_relaxed); }
+};
+
+StringInterner interner;
@@ -0,0 +1,171 @@
+#include <queue>
+
+/*
+ * simulated devices for READ and WRITE
+ *
+ * a process that runs READ or WRITE leaves its core and queues on the device
+ * the instruction names. a device serves one request at a time in arrival
+ * order and a request takes latency + bytes / bandwidth cycles. when a
+ * request starts, its finish cycle goes into a completion queue that the
+ * clock drains on every tick, handing the process back to the ready queue,
+ * so the core runs other work in the meantime.
+ *
+ * everything here is guarded by the scheduler's mtx.
+ * */
+struct IoDeviceStats {
+	string name;
+	long long latency;
+	long long bandwidth;
+	size_t depth = 0;			// waiting plus in service
+	size_t maxDepth = 0;
+	uint64_t reads = 0;
+	uint64_t writes = 0;
+	uint64_t bytes = 0;
+	uint64_t busyCycles = 0;	// cycles spent serving finished requests
+	uint64_t completed = 0;
+	uint64_t latencySum = 0;	// issue to completion, in cycles
+	uint64_t p50 = 0;
+	uint64_t p99 = 0;
+	uint64_t maxLatency = 0;
+};
+
+class IoDevice {
+	struct Request {
+		unique_ptr<Process> proc;
+		uint32_t bytes;
+		bool write;
+		int issued;
+	};
+
+	IoDeviceSpec spec;
+	deque<Request> queue;		// the front is in service
+	size_t maxDepth = 0;
+	uint64_t reads = 0;
+	uint64_t writes = 0;
+	uint64_t bytes = 0;
+	uint64_t busyCycles = 0;
+	LatencyHistogram latency;
+
+	int serviceCycles(uint32_t size) const {
+		return spec.latency + (size + spec.bandwidth - 1) / spec.bandwidth;
+	}
+
+public:
+	explicit IoDevice(const IoDeviceSpec& spec_) : spec(spec_) {}
+
+	const string& getName() const { return spec.name; }
+
+	/*
+	 * queues a request
+	 *
+	 * @returns int - the finish cycle if the device was idle and started it, -1 otherwise
+	 * */
+	int submit(unique_ptr<Process> p, const IoRequest& req, int cycle) {
+		(req.write ? writes : reads)++;
+		queue.push_back({move(p), req.bytes, req.write, cycle});
+		maxDepth = max(maxDepth, queue.size());
+		return queue.size() == 1 ? cycle + serviceCycles(req.bytes) : -1;
+	}
+
+	/*
+	 * retires the request in service and starts the next one
+	 *
+	 * @param next - set to the finish cycle of the next request, -1 if the device went idle
+	 * */
+	unique_ptr<Process> complete(int cycle, int& next) {
+		Request done = move(queue.front());
+		queue.pop_front();
+		bytes += done.bytes;
+		busyCycles += serviceCycles(done.bytes);
+		latency.record(cycle - done.issued);
+		next = queue.empty() ? -1 : cycle + serviceCycles(queue.front().bytes);
+		return move(done.proc);
+	}
+
+	template <typename Fn>
+	void forEach(Fn fn) const {
+		for(auto &req : queue) fn(*req.proc);
+	}
+
+	size_t depth() const { return queue.size(); }
+
+	IoDeviceStats stats() const {
+		IoDeviceStats s;
+		s.name = spec.name;
+		s.latency = spec.latency;
+		s.bandwidth = spec.bandwidth;
+		s.depth = queue.size();
+		s.maxDepth = maxDepth;
+		s.reads = reads;
+		s.writes = writes;
+		s.bytes = bytes;
+		s.busyCycles = busyCycles;
+		s.completed = latency.getCount();
+		s.latencySum = latency.getSum();
+		s.p50 = latency.percentile(50);
+		s.p99 = latency.percentile(99);
+		s.maxLatency = latency.getMax();
+		return s;
+	}
+};
+
+class IoSystem {
+	vector<unique_ptr<IoDevice>> devices;
+	//finish cycle and device of every request in service, earliest first
+	priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> completions;
+
+public:
+	void configure(const vector<IoDeviceSpec>& specs) {
+		devices.clear();
+		for(auto &spec : specs) devices.push_back(make_unique<IoDevice>(spec));
+	}
+
+	/*
+	 * parks a process that ran READ or WRITE on its device
+	 *
+	 * @returns the process itself if the device does not exist, the
+	 *          instruction then counts as done
+	 * */
+	unique_ptr<Process> submit(unique_ptr<Process> p, int cycle) {
+		IoRequest req = p->getIoRequest();
+		for(size_t d = 0; d < devices.size(); d++) {
+			if(devices[d]->getName() != req.device) continue;
+			int finish = devices[d]->submit(move(p), req, cycle);
+			if(finish >= 0) completions.push({finish, (int)d});
+			return nullptr;
+		}
+		p->completeIo();
+		return p;
+	}
+
+	//hands every process whose request finished by cycle to ready
+	template <typename Fn>
+	void complete(int cycle, Fn ready) {
+		while(!completions.empty() && completions.top().first <= cycle) {
+			int d = completions.top().second;
+			completions.pop();
+			int next;
+			unique_ptr<Process> p = devices[d]->complete(cycle, next);
+			if(next >= 0) completions.push({next, d});
+			p->completeIo();
+			ready(move(p));
+		}
+	}
+
+	template <typename Fn>
+	void forEach(Fn fn) const {
+		for(auto &device : devices) device->forEach(fn);
+	}
+
+	size_t waiting() const {
+		size_t n = 0;
+		for(auto &device : devices) n += device->depth();
+		return n;
+	}
+
+	vector<IoDeviceStats> stats() const {
+		vector<IoDeviceStats> all;
+		for(auto &device : devices) all.push_back(device->stats());
+		return all;
+	}
+};
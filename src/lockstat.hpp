@@ -0,0 +1,141 @@
+/*
+ * lock contention profiling
+ *
+ * every place that takes one of the scheduler mutexes names a LockSite. when
+ * built with -DCSOPESY_LOCKSTAT the site counts acquisitions, contended
+ * acquisitions, wait time and hold time; otherwise ProfiledLock is a plain
+ * lock_guard and the sites are empty.
+ * */
+#ifdef CSOPESY_LOCKSTAT
+
+struct LockSite;
+
+vector<LockSite*>& lockSites() {
+	static vector<LockSite*> sites;
+	return sites;
+}
+
+struct LockSite {
+	const char* name;
+	atomic<uint64_t> acquisitions{0};
+	atomic<uint64_t> contended{0};
+	atomic<uint64_t> waitNs{0};
+	atomic<uint64_t> maxWaitNs{0};
+	atomic<uint64_t> holdNs{0};
+	atomic<uint64_t> maxHoldNs{0};
+
+	LockSite(const char* name_) :
+		name(name_)
+	{
+		lockSites().push_back(this);
+	}
+
+	static void raise(atomic<uint64_t>& peak, uint64_t v) {
+		uint64_t prev = peak.load(memory_order_relaxed);
+		while(v > prev && !peak.compare_exchange_weak(prev, v, memory_order_relaxed)) {}
+	}
+
+	void reset() {
+		acquisitions = 0;
+		contended = 0;
+		waitNs = 0;
+		maxWaitNs = 0;
+		holdNs = 0;
+		maxHoldNs = 0;
+	}
+};
+
+class ProfiledLock {
+	mutex& m;
+	LockSite& site;
+	SteadyClock::time_point acquired;
+
+public:
+	ProfiledLock(mutex& m_, LockSite& site_) :
+		m(m_),
+		site(site_)
+	{
+		if(!m.try_lock()) {
+			auto waitStart = SteadyClock::now();
+			m.lock();
+			uint64_t wait = elapsedNs(waitStart);
+			site.contended.fetch_add(1, memory_order_relaxed);
+			site.waitNs.fetch_add(wait, memory_order_relaxed);
+			LockSite::raise(site.maxWaitNs, wait);
+		}
+		site.acquisitions.fetch_add(1, memory_order_relaxed);
+		acquired = SteadyClock::now();
+	}
+
+	~ProfiledLock() {
+		uint64_t hold = elapsedNs(acquired);
+		m.unlock();
+		site.holdNs.fetch_add(hold, memory_order_relaxed);
+		LockSite::raise(site.maxHoldNs, hold);
+	}
+
+	ProfiledLock(const ProfiledLock&) = delete;
+	ProfiledLock& operator=(const ProfiledLock&) = delete;
+};
+
+void printLockStats(ostream& out = cout) {
+	out << fixed << setprecision(3);
+	out << "site\t\t\tacquired\tcontended\twait ms\tmax wait us\thold ms\tmax hold us" << endl;
+	for(LockSite* site : lockSites()) {
+		uint64_t acq = site->acquisitions.load(memory_order_relaxed);
+		uint64_t cont = site->contended.load(memory_order_relaxed);
+		out << left << setw(24) << site->name << right
+			<< acq << "\t\t"
+			<< cont << " (" << (acq ? 100.0 * cont / acq : 0.0) << "%)\t"
+			<< site->waitNs.load(memory_order_relaxed) / 1e6 << "\t"
+			<< site->maxWaitNs.load(memory_order_relaxed) / 1e3 << "\t\t"
+			<< site->holdNs.load(memory_order_relaxed) / 1e6 << "\t"
+			<< site->maxHoldNs.load(memory_order_relaxed) / 1e3 << endl;
+	}
+	out << defaultfloat;
+}
+
+void resetLockStats() {
+	for(LockSite* site : lockSites()) site->reset();
+}
+
+#else
+
+struct LockSite {
+	constexpr LockSite(const char*) {}
+};
+
+class ProfiledLock : lock_guard<mutex> {
+public:
+	ProfiledLock(mutex& m, LockSite&) :
+		lock_guard<mutex>(m)
+	{}
+};
+
+void printLockStats(ostream& out = cout) {
+	out << "lockstat is not compiled in, rebuild with -DCSOPESY_LOCKSTAT" << endl;
+}
+
+void resetLockStats() {}
+
+#endif
+
+//sites reported by lockstat
+LockSite siteAdd("mtx: add");
+LockSite siteDispatch("mtx: dispatch");
+LockSite siteRequeue("mtx: requeue");
+LockSite siteGenerator("mtx: generator");
+LockSite siteSnapshot("mtx: snapshot");
+LockSite siteStats("mtx: stats");
+LockSite siteTrace("mtx: trace");
+LockSite siteSearch("mtx: search");
+LockSite siteTick("mtx: tick");
+LockSite siteReconfigure("mtx: reconfigure");
+LockSite siteCheckpoint("mtx: checkpoint");
+LockSite siteCluster("mtx: cluster");
+LockSite siteCoreDispatch("coreMtx: dispatch");
+LockSite siteCoreExec("coreMtx: exec");
+LockSite siteCoreRelease("coreMtx: release");
+LockSite siteCoreSnapshot("coreMtx: snapshot");
+LockSite siteCoreTrace("coreMtx: trace");
+LockSite siteCoreSearch("coreMtx: search");
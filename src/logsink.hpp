@@ -0,0 +1,267 @@
+#include <cstdint>
+#include <cstring>
+#include <array>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+//names files apart when several emulators share a directory
+inline int processTag() {
+#ifndef _WIN32
+	return getpid();
+#else
+	return _getpid();
+#endif
+}
+
+/*
+ * fixed size PRINT record as it is laid out in a log segment
+ *
+ * seq is the 1-based index of the log inside its process and is stored last,
+ * so a record with seq == 0 is either unused or still being written. prev is
+ * the position of the record the process wrote before this one, so a
+ * process's logs are read without scanning anybody else's
+ * */
+struct LogRecord {
+	int32_t pid;
+	int32_t core;
+	uint32_t msgId;
+	atomic<uint32_t> seq;
+	int32_t cycle;
+	uint32_t prev;		// LogSink::NO_RECORD for the first
+	int64_t timestamp;
+};
+static_assert(sizeof(LogRecord) == 32, "log records must stay 32 bytes");
+
+/*
+ * append-only log of PRINT records split into fixed size segment files
+ *
+ * segments are memory mapped and handed out to cores in chunks with a single
+ * atomic add, so writers never take a lock unless a new segment has to be
+ * created. records are readable as soon as their seq is published.
+ * */
+class LogSink {
+public:
+	static constexpr size_t SEGMENT_RECORDS = 1 << 20;
+	static constexpr size_t CHUNK_RECORDS = 64;
+	static constexpr int MAX_SEGMENTS = 1024;
+	//positions count records from the start of segment 0
+	static constexpr uint32_t NO_RECORD = UINT32_MAX;
+	static_assert(SEGMENT_RECORDS * MAX_SEGMENTS < NO_RECORD, "record positions must fit 32 bits");
+
+private:
+	struct Segment {
+		LogRecord* base = nullptr;
+		atomic<size_t> next{0};
+		int fd = -1;
+	};
+
+	array<atomic<Segment*>, MAX_SEGMENTS> segments;
+	atomic<int> segmentCount;
+	mutex growMtx;
+	string prefix;
+
+public:
+	/*
+	 * segments are files <prefix>.<pid>.<n>.seg, so another emulator in the
+	 * same directory never maps them, and they are removed with the sink.
+	 * an empty prefix keeps the segments in anonymous memory, no files
+	 * */
+	LogSink(string prefix_ = "csopesy-print") :
+		segmentCount(0),
+		prefix(prefix_.empty() ? "" : prefix_ + "." + to_string(processTag()))
+	{
+		for(auto &seg : segments) seg = nullptr;
+	}
+
+	~LogSink() {
+		int count = segmentCount;
+		for(int i = 0; i < count; i++) {
+			Segment* seg = segments[i];
+#ifndef _WIN32
+			munmap(seg->base, SEGMENT_RECORDS * sizeof(LogRecord));
+			if(seg->fd >= 0) {
+				close(seg->fd);
+				unlink(segmentPath(i).c_str());
+			}
+#else
+			free(seg->base);
+#endif
+			delete seg;
+		}
+	}
+
+	/*
+	 * reserves a chunk of CHUNK_RECORDS consecutive records
+	 *
+	 * @param first - set to the position of the first record of the chunk
+	 * @returns LogRecord* - first record of the chunk, nullptr if the log is full
+	 * */
+	LogRecord* reserve(uint32_t& first) {
+		while(true) {
+			int count = segmentCount.load(memory_order_acquire);
+			if(count > 0) {
+				Segment* seg = segments[count - 1].load(memory_order_acquire);
+				size_t idx = seg->next.fetch_add(CHUNK_RECORDS, memory_order_relaxed);
+				if(idx + CHUNK_RECORDS <= SEGMENT_RECORDS) {
+					first = (count - 1) * SEGMENT_RECORDS + idx;
+					return seg->base + idx;
+				}
+			}
+			if(!grow(count)) return nullptr;
+		}
+	}
+
+	/*
+	 * calls fn for every published record of a process in the order it logged
+	 *
+	 * follows the prev links back from the newest record, so the cost is the
+	 * process's own logs. restored logs may be linked out of order, the
+	 * records are sorted by seq before fn sees them
+	 *
+	 * @param pid - process to read
+	 * @param last - position of the newest record the process published
+	 * */
+	template <typename Fn>
+	void forEach(int pid, uint32_t last, Fn fn) {
+		vector<const LogRecord*> found;
+		for(uint32_t pos = last; pos != NO_RECORD; ) {
+			const LogRecord* rec = at(pos);
+			if(!rec || rec->pid != pid || rec->seq.load(memory_order_acquire) == 0) break;
+			found.push_back(rec);
+			pos = rec->prev;
+		}
+
+		sort(found.begin(), found.end(), [](const LogRecord* a, const LogRecord* b) {
+			return a->seq.load(memory_order_relaxed) < b->seq.load(memory_order_relaxed);
+		});
+		for(const LogRecord* rec : found) {
+			fn(*rec);
+		}
+	}
+
+	//calls fn for every published record in the order they sit in the segments
+	template <typename Fn>
+	void forEachRecord(Fn fn) {
+		int count = segmentCount.load(memory_order_acquire);
+		for(int s = 0; s < count; s++) {
+			Segment* seg = segments[s].load(memory_order_acquire);
+			size_t used = min(seg->next.load(memory_order_acquire), SEGMENT_RECORDS);
+			for(size_t i = 0; i < used; i++) {
+				const LogRecord& rec = seg->base[i];
+				if(rec.seq.load(memory_order_acquire) != 0)
+					fn(rec);
+			}
+		}
+	}
+
+	int getSegmentCount() { return segmentCount.load(memory_order_acquire); }
+
+	//the record at a position, nullptr past the mapped segments
+	const LogRecord* at(uint32_t pos) {
+		int s = pos / SEGMENT_RECORDS;
+		if(s >= segmentCount.load(memory_order_acquire)) return nullptr;
+		return segments[s].load(memory_order_acquire)->base + pos % SEGMENT_RECORDS;
+	}
+
+private:
+	string segmentPath(int index) const { return prefix + "." + to_string(index) + ".seg"; }
+
+	//maps a new segment unless another core already did it
+	bool grow(int seen) {
+		lock_guard<mutex> lock(growMtx);
+		if(segmentCount.load(memory_order_relaxed) != seen) return true;
+		if(seen >= MAX_SEGMENTS) return false;
+
+		size_t bytes = SEGMENT_RECORDS * sizeof(LogRecord);
+		auto seg = new Segment();
+#ifndef _WIN32
+		void* base;
+		if(prefix.empty()) {
+			base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		} else {
+			string path = segmentPath(seen);
+			seg->fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if(seg->fd < 0 || ftruncate(seg->fd, bytes) != 0) {
+				cerr << "[Error] Could not create log segment " << path << endl;
+				delete seg;
+				return false;
+			}
+			base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+		}
+		if(base == MAP_FAILED) {
+			cerr << "[Error] Could not map log segment " << seen << endl;
+			if(seg->fd >= 0) close(seg->fd);
+			delete seg;
+			return false;
+		}
+		seg->base = static_cast<LogRecord*>(base);
+#else
+		seg->base = static_cast<LogRecord*>(calloc(SEGMENT_RECORDS, sizeof(LogRecord)));
+#endif
+		segments[seen].store(seg, memory_order_release);
+		segmentCount.store(seen + 1, memory_order_release);
+		return true;
+	}
+};
+
+LogSink logSink;
+
+/*
+ * per-core write position inside the sink
+ *
+ * only the owning core touches it, the sink is consulted once per chunk
+ * */
+struct LogCursor {
+	int core;
+	const atomic<int>* clock;
+	LogSink* sink;
+	LogRecord* pos;
+	LogRecord* end;
+	uint32_t position;		// of pos
+
+	LogCursor(int core_, const atomic<int>* clock_ = nullptr, LogSink* sink_ = &logSink) :
+		core(core_),
+		clock(clock_),
+		sink(sink_),
+		pos(nullptr),
+		end(nullptr),
+		position(LogSink::NO_RECORD)
+	{}
+
+	/*
+	 * appends one record
+	 *
+	 * @param prev - position of the process's previous record
+	 * @returns uint32_t - position of the record, LogSink::NO_RECORD if the log is full
+	 * */
+	uint32_t append(int pid, uint32_t msgId, uint32_t seq, time_t timestamp, uint32_t prev) {
+		return put(pid, core, msgId, seq, clock ? clock->load(memory_order_relaxed) : 0, timestamp, prev);
+	}
+
+	//appends a record with a given core and cycle, used when restoring a checkpoint
+	uint32_t put(int pid, int recCore, uint32_t msgId, uint32_t seq, int64_t cycle, int64_t timestamp, uint32_t prev) {
+		if(pos == end) {
+			pos = sink->reserve(position);
+			if(!pos) {
+				end = nullptr;
+				return LogSink::NO_RECORD;
+			}
+			end = pos + LogSink::CHUNK_RECORDS;
+		}
+
+		LogRecord* rec = pos++;
+		rec->pid = pid;
+		rec->core = recCore;
+		rec->msgId = msgId;
+		rec->cycle = (int32_t)cycle;
+		rec->prev = prev;
+		rec->timestamp = timestamp;
+		rec->seq.store(seq, memory_order_release);
+		return position++;
+	}
+};
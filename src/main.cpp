@@ -17,16 +17,60 @@ atomic<bool> running(true);
 /***************************/
 
 /* HEADERS *****************/
-#include "initialize.hpp"
 #include "instruction.hpp"
+#include "interner.hpp"
+#include "logsink.hpp"
+#include "counters.hpp"
+#include "trace.hpp"
+#include "coroutine.hpp"
+#include "initialize.hpp"
 #include "process.hpp"
 #include "helper.hpp"
+#include "stats.hpp"
+#include "admission.hpp"
+#include "io.hpp"
+#include "checkpoint.hpp"
+#include "report.hpp"
+#include "console.hpp"
+#include "lockstat.hpp"
+#include "affinity.hpp"
+#include "barrier.hpp"
 #include "scheduler.hpp"
+#include "top.hpp"
+#include "control.hpp"
+#include "cluster.hpp"
+#include "metrics.hpp"
+#include "compare.hpp"
 #include "mainController.hpp"
+#include "batch.hpp"
 /****************************/
 
-int main()
+int main(int argc, char* argv[])
 {
+	//--compare runs a headless scheduler comparison
+	if (argc > 1 && string(argv[1]) == "--compare")
+	{
+		CompareOptions opts;
+		if (!parseCompareArgs(argc, argv, opts))
+		{
+			printCompareUsage();
+			return 2;
+		}
+		return runCompare(opts);
+	}
+
+	//any other argument switches to headless batch mode
+	if (argc > 1)
+	{
+		BatchOptions opts;
+		if (!parseBatchArgs(argc, argv, opts))
+		{
+			printBatchUsage();
+			return 2;
+		}
+		return runBatch(opts);
+	}
+
 	MainController os;
 	os.run();
 }
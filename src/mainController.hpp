@@ -2,136 +2,584 @@
 
 class MainController
 {
-	string rawInput;
 	vector<string> cmd;
 	bool initialized;
+	int screen;			// pid of the process whose screen is open, -1 at the main menu
+	string screenName;
+	unique_ptr<ControlServer> control;
+	unique_ptr<MetricsExporter> metrics;
+	unique_ptr<ClusterNode> cluster;
+	long long clusterInterval = 500;
 
 public:
 	MainController() :
-		initialized(false)
+		initialized(false),
+		screen(-1)
 	{}
 
+	/*
+	 * executor loop, runs queued commands one at a time
+	 *
+	 * input is read by its own thread so typing never waits for a command,
+	 * and every command writes through a ConsoleStream that streams its
+	 * output in chunks and stops early once the command is cancelled
+	 * */
 	void run()
 	{	
 		Scheduler scheduler;
-		thread t;
-		int pid = 0;
+		signal(SIGINT, onInterrupt);
+		thread(readInput).detach();
 
 		while (running)
 		{
-			cout << "root:\\> ";
-			getline(cin, rawInput);
+			consoleWrite("root:\\> ");
+			string rawInput;
+			if (!commandQueue.pop(rawInput))
+				break;
 			cmd = tokenizeInput(rawInput);
+			if (cmd.empty())
+				continue;
 
-			if (!initialized)
+			cancelRequested = false;
+			commandRunning = true;
 			{
-				if (cmd[0] == "initialize")
-				{
-					Config cfg;
-					cout << "initializing processor configuration..." << endl;
+				ConsoleStream out;
+				if (screen >= 0)
+					handleScreenCommand(scheduler, out);
+				else
+					execute(scheduler, out);
+			}
+			commandRunning = false;
+			if (cancelRequested)
+				consoleWrite("^C\n");
+		}
+		//stops before the scheduler it submits to goes away
+		control.reset();
+		metrics.reset();
+		cluster.reset();
+	}
 
-					if (cfg.loadFile())
-					{
-						std::cout << "configuration loaded successfully.\n\n";
-						cfg.print();
-						// initializes the scheduler
-						scheduler.configure(cfg);
-						scheduler.start();
-						//initialize instructions
-						minIns = cfg.minIns;
-						maxIns = cfg.maxIns;
-						std::cout << "scheduler started successfully.\n\n";
-						initialized = true;
-						
-						t = thread([&scheduler]() { scheduler.simulate(); });
-						t.detach();
-					}
-					else
-					{
-						std::cerr << "failed to load configuration.\n\n";
-					}
-				}
-				else if (cmd[0] == "exit")
+	void execute(Scheduler& scheduler, ostream& out)
+	{
+		if (!initialized)
+		{
+			if (cmd[0] == "initialize")
+			{
+				Config cfg;
+				out << "initializing processor configuration..." << endl;
+
+				if (cfg.loadFile())
 				{
-					cout << "exiting program..." << endl;
-					running = false;
+					out << "configuration loaded successfully.\n\n";
+					cfg.print(out);
+					// initializes the scheduler
+					scheduler.configure(cfg);
+					scheduler.start();
+					startEmulator(scheduler, cfg, out);
 				}
 				else
 				{
-					cout << "Please initialize first!" << endl;
+					std::cerr << "failed to load configuration.\n\n";
+				}
+			}
+			else if (cmd[0] == "restore")
+			{
+				//a checkpoint stands in for config.txt and scheduler-test
+				Config cfg;
+				if (cmd.size() < 2)
+				{
+					out << "Usage: restore <file>" << endl;
 				}
+				else if (scheduler.restore(cmd[1], cfg, out))
+				{
+					out << "\n";
+					cfg.print(out);
+					scheduler.start();
+					startEmulator(scheduler, cfg, out);
+					if (scheduler.resumesTest())
+						scheduler.startTest(false);
+				}
+			}
+			else if (cmd[0] == "scheduler-compare")
+			{
+				handleCompareCommand(out);
+			}
+			else if (cmd[0] == "exit")
+			{
+				out << "exiting program..." << endl;
+				running = false;
+			}
+			else
+			{
+				out << "Please initialize or restore first!" << endl;
 			}
+		}
 
-			else if (initialized)
+		else if (initialized)
+		{
+			if (cmd[0] == "screen")
 			{
-				if (cmd[0] == "screen")
+				if (cmd.size() == 1)
+				{
+					out << "Missing argument after 'screen'" << endl;
+				}
+				else if (cmd[1] == "-s")
 				{
-					if (cmd.size() == 1)
+					if (cmd.size() == 2)
 					{
-						cout << "Missing argument after 'screen'" << endl;
+						scheduler.addProcess(createRandomProcess());
+						enterScreen(scheduler, "PROC-"+to_string(nextId-1), out);
 					}
-					else if (cmd[1] == "-s")
+					else
 					{
-						if (cmd.size() == 2)
-						{
-							scheduler.addProcess(createRandomProcess());
-							scheduler.enterProcessScreen(("PROC-"+to_string(nextId-1)));
-						}
-						else
-						{
-							scheduler.addProcess(createRandomProcess(cmd[2]));
-							scheduler.enterProcessScreen(cmd[2]);
-						}
+						scheduler.addProcess(createRandomProcess(cmd[2]));
+						enterScreen(scheduler, cmd[2], out);
 					}
-					else if (cmd[1] == "-r")
+				}
+				else if (cmd[1] == "-r")
+				{
+					if (cmd.size() == 2)
 					{
-						if (cmd.size() == 2)
-						{
-							cout << "Missing argument: Process Name" << endl;
-						}
-						else
-						{
-							scheduler.enterProcessScreen(cmd[2]);
-						}
+						out << "Missing argument: Process Name" << endl;
 					}
-					else if (cmd[1] == "-ls") {
-						scheduler.state();
+					else
+					{
+						enterScreen(scheduler, cmd[2], out);
 					}
 				}
-				else if (cmd[0] == "scheduler-start" || cmd[0] == "scheduler-test")
+				else if (cmd[1] == "-ls") {
+					scheduler.state(out);
+				}
+			}
+			else if (cmd[0] == "scheduler-start" || cmd[0] == "scheduler-test")
+			{
+				scheduler.startTest(false);
+				out << "Test has started..." << endl;
+			}
+			else if (cmd[0] == "scheduler-stop")
+			{
+				scheduler.stopTest();
+			}
+			else if (cmd[0] == "scheduler-compare")
+			{
+				handleCompareCommand(out);
+			}
+			else if (cmd[0] == "vmstat")
+			{
+				int windowMs = 1000;
+				if (cmd.size() >= 2)
 				{
-					scheduler.startTest();
+					try { windowMs = stoi(cmd[1]); } catch (...) { windowMs = -1; }
 				}
-				else if (cmd[0] == "scheduler-stop")
+				if (windowMs <= 0)
+					out << "Usage: vmstat [window_ms]" << endl;
+				else
+					scheduler.vmstat(out, windowMs);
+			}
+			else if (cmd[0] == "trace")
+			{
+				if (cmd.size() >= 2 && (cmd[1] == "on" || cmd[1] == "off"))
 				{
-					scheduler.stopTest();
+					scheduler.setTracing(cmd[1] == "on");
+					out << "tracing " << cmd[1] << endl;
 				}
-				else if (cmd[0] == "report-util")
+				else
 				{
-					handleReportCommand(scheduler);
-					cout << "report file created at ./csopesy-log.txt" << endl;
+					out << "Usage: trace <on|off>" << endl;
 				}
-				else if (cmd[0] == "exit")
+			}
+			else if (cmd[0] == "trace-dump")
+			{
+				if (cmd.size() < 2)
+					out << "Usage: trace-dump <file>" << endl;
+				else if (scheduler.dumpTrace(cmd[1]))
+					out << "trace written to " << cmd[1] << endl;
+				else
+					out << "Nothing to dump, enable tracing with 'trace on' first." << endl;
+			}
+			else if (cmd[0] == "lockstat")
+			{
+				if (cmd.size() >= 2 && cmd[1] == "reset")
+					resetLockStats();
+				else
+					printLockStats(out);
+			}
+			else if (cmd[0] == "top")
+			{
+				int refreshMs = 1000;
+				if (cmd.size() >= 2)
 				{
-					cout << "exiting program..." << endl;
-					running = false;
+					try { refreshMs = stoi(cmd[1]); } catch (...) { refreshMs = -1; }
 				}
+				if (refreshMs <= 0)
+					out << "Usage: top [refresh_ms]" << endl;
+				else
+					TopScreen(refreshMs).run(scheduler, out);
+			}
+			else if (cmd[0] == "stats")
+			{
+				out << scheduler.latencySummary(true);
+			}
+			else if (cmd[0] == "iostat")
+			{
+				out << scheduler.ioSummary();
+			}
+			else if (cmd[0] == "report-util")
+			{
+				handleReportCommand(scheduler, out);
+			}
+			else if (cmd[0] == "control")
+			{
+				handleControlCommand(out);
+			}
+			else if (cmd[0] == "metrics")
+			{
+				handleMetricsCommand(out);
+			}
+			else if (cmd[0] == "cluster")
+			{
+				handleClusterCommand(out);
+			}
+			else if (cmd[0] == "checkpoint")
+			{
+				if (cmd.size() < 2)
+					out << "Usage: checkpoint <file>" << endl;
 				else
+					scheduler.checkpoint(cmd[1], out);
+			}
+			else if (cmd[0] == "restore")
+			{
+				out << "restore replaces everything, run it right after starting instead of initialize." << endl;
+			}
+			else if (cmd[0] == "reconfigure")
+			{
+				handleReconfigureCommand(scheduler, out);
+			}
+			else if (cmd[0] == "exit")
+			{
+				out << "exiting program..." << endl;
+				running = false;
+			}
+			else
+			{
+				out << "Unknown command." << endl;
+			}
+		}
+	}
+
+	//what initialize and restore share once the scheduler is running
+	void startEmulator(Scheduler& scheduler, const Config& cfg, ostream& out)
+	{
+		//initialize instructions
+		minIns = cfg.minIns;
+		maxIns = cfg.maxIns;
+		workloadSeed = cfg.seed >= 0 ? cfg.seed : time(nullptr);
+		out << "workload seed " << workloadSeed << "\n";
+		out << "scheduler started successfully.\n\n";
+		initialized = true;
+
+		control = make_unique<ControlServer>(scheduler);
+		if (!cfg.controlSocket.empty())
+		{
+			if (control->start(cfg.controlSocket))
+				out << "control socket listening on " << cfg.controlSocket << "\n\n";
+			else
+				out << "could not open control socket " << cfg.controlSocket << "\n\n";
+		}
+
+		metrics = make_unique<MetricsExporter>(scheduler);
+		if (!cfg.metricsFile.empty())
+		{
+			metrics->start(cfg.metricsFile, cfg.metricsInterval);
+			out << "writing metrics to " << cfg.metricsFile << " every " << cfg.metricsInterval << "ms\n\n";
+		}
+
+		cluster = make_unique<ClusterNode>(scheduler);
+		clusterInterval = cfg.clusterInterval;
+		if (!cfg.clusterListen.empty() || !cfg.clusterPeers.empty())
+		{
+			string name = cfg.clusterName.empty() ? defaultNodeName(cfg.clusterListen) : cfg.clusterName;
+			if (cluster->start(name, cfg.clusterListen, splitList(cfg.clusterPeers), clusterInterval))
+				out << "cluster node " << name << (cfg.clusterListen.empty() ? "" : " listening on " + cfg.clusterListen) << "\n\n";
+			else
+				out << "could not open cluster address " << cfg.clusterListen << "\n\n";
+		}
+	}
+
+	//screen -s / -r, the process screen is a state of the controller
+	void enterScreen(Scheduler& scheduler, const string& name, ostream& out)
+	{
+		auto proc = scheduler.describeProcess(name);
+		if (!proc)
+		{
+			out << "Process <" << name << "> not found." << endl;
+			return;
+		}
+		//clear screen
+		out << "\033[2J\033[1;1H";
+		screen = proc->pid;
+		screenName = name;
+	}
+
+	//the process is copied again for every command, it may have moved to another node
+	void handleScreenCommand(Scheduler& scheduler, ostream& out)
+	{
+		if (cmd[0] == "exit")
+		{
+			out << "Returning home..." << endl;
+			screen = -1;
+			return;
+		}
+
+		auto proc = scheduler.describeProcess(screen);
+		if (!proc)
+		{
+			string peer = cluster ? cluster->migratedTo(screen) : "";
+			out << "Process <" << screenName << "> "
+				<< (peer.empty() ? "is no longer here." : "migrated to " + peer + ".") << endl;
+			out << "Returning home..." << endl;
+			screen = -1;
+			return;
+		}
+		const ProcessInfo& p = *proc;
+		if (cmd[0] == "process-smi")
+		{
+			out << endl;
+			out << "Process name: " << p.name << endl;
+			out << "ID: " << p.pid << endl;
+			out << "Migrations: " << p.migrations << endl;
+			out << "Logs:" << endl;
+			p.writeLogs(out);
+			out << endl;
+			if(p.instructionPointer != p.instructionCount) {
+				out << "Current instruction Line: " << p.instructionPointer << endl;
+				out << "Lines of code: " << p.instructionCount << endl
+					<< endl;
+			} else {
+				out << "Finished!" << endl
+					<< endl;
+			}
+		}
+		else
+		{
+			out << "Unknown command inside process screen." << endl;
+		}
+	}
+
+	void handleReportCommand(Scheduler& scheduler, ostream& out) {
+		//report-util auto <N|off>
+		if (cmd.size() >= 3 && cmd[1] == "auto")
+		{
+			int cycles = 0;
+			if (cmd[2] != "off")
+			{
+				try { cycles = stoi(cmd[2]); } catch (...) { cycles = -1; }
+				if (cycles <= 0)
 				{
-					cout << "Unknown command." << endl;
+					out << "Usage: report-util auto <cycles|off>" << endl;
+					return;
 				}
 			}
+			scheduler.setAutoReport(cycles);
+			if (cycles > 0)
+				out << "auto report every " << cycles << " cycles to ./csopesy-log.txt" << endl;
+			else
+				out << "auto report disabled" << endl;
+			return;
+		}
+
+		scheduler.requestReport();
+		out << "report file will be written to ./csopesy-log.txt in the background" << endl;
+	}
+
+	void handleControlCommand(ostream& out) {
+		//control start [path] | control stop | control
+		if (cmd.size() >= 2 && cmd[1] == "start")
+		{
+			string path = cmd.size() >= 3 ? cmd[2] : "csopesy.sock";
+			if (control->start(path))
+				out << "control socket listening on " << path << endl;
+			else
+				out << "could not open control socket " << path << endl;
+		}
+		else if (cmd.size() >= 2 && cmd[1] == "stop")
+		{
+			control->shutdown();
+			out << "control socket closed" << endl;
+		}
+		else if (control->isRunning())
+		{
+			out << "control socket " << control->getPath() << ", "
+				<< control->getSubmitted() << " processes submitted" << endl;
+		}
+		else
+		{
+			out << "Usage: control start [path] | control stop" << endl;
+		}
+	}
+
+	void handleMetricsCommand(ostream& out) {
+		//metrics start <file> [interval_ms] | metrics stop | metrics
+		if (cmd.size() >= 3 && cmd[1] == "start")
+		{
+			int intervalMs = 5000;
+			if (cmd.size() >= 4)
+			{
+				try { intervalMs = stoi(cmd[3]); } catch (...) { intervalMs = -1; }
+			}
+			if (intervalMs < 100)
+			{
+				out << "Usage: metrics start <file> [interval_ms >= 100]" << endl;
+				return;
+			}
+			metrics->start(cmd[2], intervalMs);
+			out << "writing metrics to " << cmd[2] << " every " << intervalMs << "ms" << endl;
+		}
+		else if (cmd.size() >= 2 && cmd[1] == "stop")
+		{
+			metrics->shutdown();
+			out << "metrics exporter stopped" << endl;
+		}
+		else if (metrics->isRunning())
+		{
+			out << "metrics " << metrics->getPath() << " every " << metrics->getInterval()
+				<< "ms, " << metrics->getWrites() << " writes" << endl;
+		}
+		else
+		{
+			out << "Usage: metrics start <file> [interval_ms] | metrics stop" << endl;
 		}
 	}
 
-	void handleReportCommand(Scheduler& scheduler) {
-    
-    std::string report = scheduler.reportUtil();
+	//the listen address names a node unless cluster_name does
+	static string defaultNodeName(const string& listen)
+	{
+		if (!listen.empty())
+			return listen;
+#ifndef _WIN32
+		return "node-" + to_string(getpid());
+#else
+		return "node-" + to_string(time(nullptr) % 100000);
+#endif
+	}
 
-    std::ofstream outFile("csopesy-log.txt");
-    outFile << report;
-    outFile.close();
-}
+	static vector<string> splitList(const string& list)
+	{
+		vector<string> items;
+		stringstream ss(list);
+		string item;
+		while (getline(ss, item, ','))
+		{
+			if (!item.empty())
+				items.push_back(item);
+		}
+		return items;
+	}
+
+	void handleClusterCommand(ostream& out) {
+		//cluster start <name> <listen|-> [peer,...] | cluster join <address> | cluster stop | cluster
+		if (cmd.size() >= 4 && cmd[1] == "start")
+		{
+			string listen = cmd[3] == "-" ? "" : cmd[3];
+			vector<string> peers = cmd.size() >= 5 ? splitList(cmd[4]) : vector<string>();
+			if (listen.empty() && peers.empty())
+			{
+				out << "Usage: cluster start <name> <listen|-> [peer,...], a node listens or dials" << endl;
+				return;
+			}
+			if (cluster->start(cmd[2], listen, peers, clusterInterval))
+				out << "cluster node " << cmd[2] << (listen.empty() ? "" : " listening on " + listen) << endl;
+			else
+				out << "could not open cluster address " << listen << endl;
+		}
+		else if (cmd.size() >= 3 && cmd[1] == "join" && cluster->isRunning())
+		{
+			cluster->join(cmd[2]);
+			out << "dialing " << cmd[2] << endl;
+		}
+		else if (cmd.size() >= 2 && cmd[1] == "stop")
+		{
+			cluster->shutdown();
+			out << "cluster node stopped" << endl;
+		}
+		else if (cmd.size() == 1 && cluster->isRunning())
+		{
+			out << cluster->summary();
+		}
+		else
+		{
+			out << "Usage: cluster start <name> <listen|-> [peer,...] | cluster join <address> | cluster stop" << endl;
+		}
+	}
+
+	void handleCompareCommand(ostream& out) {
+		//scheduler-compare <seed> [processes] [variants], on top of config.txt
+		CompareOptions opts;
+		try
+		{
+			if (cmd.size() >= 2) opts.seed = stoull(cmd[1]);
+			if (cmd.size() >= 3) opts.processes = stoi(cmd[2]);
+			opts.seeded = cmd.size() >= 2;
+		}
+		catch (...)
+		{
+			opts.seeded = false;
+		}
+		if (cmd.size() >= 4)
+			opts.variants = cmd[3];
+
+		Config cfg;
+		vector<CompareVariant> variants;
+		if (!opts.seeded || opts.processes <= 0)
+		{
+			out << "Usage: scheduler-compare <seed> [processes] [fcfs,rr:<quantum>,...]" << endl;
+		}
+		else if (!cfg.loadFile())
+		{
+			out << "failed to load configuration." << endl;
+		}
+		else if (!parseVariants(opts.variants, cfg.quantumCycles, variants))
+		{
+			out << "Usage: scheduler-compare <seed> [processes] [fcfs,rr:<quantum>,...]" << endl;
+		}
+		else
+		{
+			out << "running " << variants.size() << " variants on " << opts.processes << " processes..." << endl;
+			runComparison(cfg, variants, opts.seed, opts.processes, out);
+		}
+	}
+
+	void handleReconfigureCommand(Scheduler& scheduler, ostream& out) {
+		//reconfigure watch <file|off>
+		if (cmd.size() >= 2 && cmd[1] == "watch")
+		{
+			string path = cmd.size() >= 3 ? cmd[2] : "config.txt";
+			if (path == "off")
+			{
+				scheduler.stopWatch();
+				out << "config watch disabled" << endl;
+			}
+			else
+			{
+				scheduler.watchConfig(path);
+				out << "watching " << path << " for changes" << endl;
+			}
+			return;
+		}
+
+		//reconfigure [file]
+		string path = cmd.size() >= 2 ? cmd[1] : "config.txt";
+		Config cfg;
+		if (cfg.loadFile(path))
+		{
+			scheduler.reconfigure(cfg, out);
+			out << "configuration applied." << endl;
+		}
+		else
+		{
+			out << "Usage: reconfigure [file] | reconfigure watch [file|off]" << endl;
+		}
+	}
 };
 
 
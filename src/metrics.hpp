@@ -0,0 +1,223 @@
+/*
+ * prometheus textfile exporter
+ *
+ * a background thread renders the scheduler's counters, queue sizes and
+ * latency histograms in the text exposition format every interval. the text
+ * goes to <path>.tmp, which is renamed over <path>, so node-exporter's
+ * textfile collector never scrapes half a file.
+ *
+ * latency buckets are the non-empty buckets of LatencyHistogram, cumulative
+ * as prometheus expects. counts only grow, so once a bucket shows up it
+ * stays in every later file.
+ * */
+class MetricsExporter {
+	Scheduler& scheduler;
+	string path;
+	int intervalMs;
+	thread worker;
+	mutex mtx;
+	condition_variable cv;
+	bool stop;
+	atomic<uint64_t> writes;
+
+	static void family(stringstream& ss, const char* name, const char* type, const char* help) {
+		ss << "# HELP " << name << " " << help << "\n";
+		ss << "# TYPE " << name << " " << type << "\n";
+	}
+
+	static void histogram(stringstream& ss, const char* name, const string& mode, const LatencyHistogram& h) {
+		uint64_t seen = 0;
+		for(auto &[upper, count] : h.buckets()) {
+			seen += count;
+			ss << name << "_bucket{mode=\"" << mode << "\",le=\"" << upper / 1e6 << "\"} " << seen << "\n";
+		}
+		ss << name << "_bucket{mode=\"" << mode << "\",le=\"+Inf\"} " << h.getCount() << "\n";
+		ss << name << "_sum{mode=\"" << mode << "\"} " << h.getSum() / 1e6 << "\n";
+		ss << name << "_count{mode=\"" << mode << "\"} " << h.getCount() << "\n";
+	}
+
+	void loop() {
+		unique_lock<mutex> lock(mtx);
+		while(!stop) {
+			lock.unlock();
+			writeOnce();
+			lock.lock();
+			cv.wait_for(lock, chrono::milliseconds(intervalMs), [this]() { return stop; });
+		}
+	}
+
+public:
+	explicit MetricsExporter(Scheduler& scheduler_) :
+		scheduler(scheduler_),
+		intervalMs(0),
+		stop(true),
+		writes(0)
+	{}
+
+	~MetricsExporter() { shutdown(); }
+
+	//one scrape worth of metrics
+	string render() {
+		vector<Core*> live = scheduler.liveCores();
+		AdmissionStats a = scheduler.admissionStats();
+		stringstream ss;
+		ss << setprecision(9);
+
+		family(ss, "csopesy_cpu_cycle", "gauge", "Current scheduler cycle.");
+		ss << "csopesy_cpu_cycle " << scheduler.getCycle() << "\n";
+		family(ss, "csopesy_cores", "gauge", "Cores taking processes (num_cpu).");
+		ss << "csopesy_cores " << scheduler.getCoreCount() << "\n";
+
+		//per core counters, parked cores keep theirs
+		struct Column {
+			const char* name;
+			const char* help;
+			uint64_t CounterTotals::* field;
+		};
+		const Column columns[] = {
+			{"csopesy_core_busy_ticks_total", "Ticks a core spent running a process.", &CounterTotals::busyTicks},
+			{"csopesy_core_idle_ticks_total", "Ticks a core spent without a process.", &CounterTotals::idleTicks},
+			{"csopesy_core_instructions_total", "Instructions executed by a core.", &CounterTotals::instructions},
+			{"csopesy_core_context_switches_total", "Processes dispatched onto a core.", &CounterTotals::contextSwitches},
+			{"csopesy_core_migrations_total", "Processes a core took over from another core.", &CounterTotals::migrations},
+		};
+		vector<CounterTotals> perCore;
+		CounterTotals total;
+		for(Core* core : live) {
+			CounterTotals t;
+			t.add(core->counters);
+			perCore.push_back(t);
+			total.add(core->counters);
+		}
+		for(auto &column : columns) {
+			family(ss, column.name, "counter", column.help);
+			for(size_t i = 0; i < live.size(); i++) {
+				ss << column.name << "{core=\"" << live[i]->id << "\"} " << perCore[i].*column.field << "\n";
+			}
+		}
+
+		family(ss, "csopesy_instructions_total", "counter", "Instructions executed by all cores.");
+		ss << "csopesy_instructions_total " << total.instructions << "\n";
+
+		family(ss, "csopesy_queue_processes", "gauge", "Processes per queue.");
+		ss << "csopesy_queue_processes{queue=\"ready\"} " << a.ready << "\n";
+		ss << "csopesy_queue_processes{queue=\"sleeping\"} " << a.sleeping << "\n";
+		ss << "csopesy_queue_processes{queue=\"io\"} " << a.ioWaiting << "\n";
+		ss << "csopesy_queue_processes{queue=\"finished\"} " << scheduler.getFinishedCount() << "\n";
+		ss << "csopesy_queue_processes{queue=\"spilled\"} " << a.spillDepth << "\n";
+		family(ss, "csopesy_resident_processes", "gauge", "Processes ready, sleeping or running.");
+		ss << "csopesy_resident_processes " << a.resident << "\n";
+
+		family(ss, "csopesy_processes_created_total", "counter", "Process ids handed out.");
+		ss << "csopesy_processes_created_total " << nextId.load() << "\n";
+		family(ss, "csopesy_processes_finished_total", "counter", "Processes that ran to completion.");
+		ss << "csopesy_processes_finished_total " << scheduler.getFinishedCount() << "\n";
+		family(ss, "csopesy_processes_dropped_total", "counter", "Arrivals rejected by admission control.");
+		ss << "csopesy_processes_dropped_total " << a.dropped << "\n";
+		family(ss, "csopesy_processes_spilled_total", "counter", "Arrivals written to the spill file.");
+		ss << "csopesy_processes_spilled_total " << a.spilled << "\n";
+
+		//simulated devices, latency in cycles
+		vector<IoDeviceStats> devices = scheduler.ioStats();
+		if(!devices.empty()) {
+			family(ss, "csopesy_io_queue_depth", "gauge", "Requests waiting on or served by a device.");
+			for(auto &d : devices) ss << "csopesy_io_queue_depth{device=\"" << d.name << "\"} " << d.depth << "\n";
+			family(ss, "csopesy_io_requests_total", "counter", "READ and WRITE requests issued to a device.");
+			for(auto &d : devices) {
+				ss << "csopesy_io_requests_total{device=\"" << d.name << "\",op=\"read\"} " << d.reads << "\n";
+				ss << "csopesy_io_requests_total{device=\"" << d.name << "\",op=\"write\"} " << d.writes << "\n";
+			}
+			family(ss, "csopesy_io_bytes_total", "counter", "Bytes moved by finished requests.");
+			for(auto &d : devices) ss << "csopesy_io_bytes_total{device=\"" << d.name << "\"} " << d.bytes << "\n";
+			family(ss, "csopesy_io_busy_cycles_total", "counter", "Cycles a device spent serving finished requests.");
+			for(auto &d : devices) ss << "csopesy_io_busy_cycles_total{device=\"" << d.name << "\"} " << d.busyCycles << "\n";
+			family(ss, "csopesy_io_latency_cycles", "summary", "Issue to completion of finished requests.");
+			for(auto &d : devices) {
+				ss << "csopesy_io_latency_cycles{device=\"" << d.name << "\",quantile=\"0.5\"} " << d.p50 << "\n";
+				ss << "csopesy_io_latency_cycles{device=\"" << d.name << "\",quantile=\"0.99\"} " << d.p99 << "\n";
+				ss << "csopesy_io_latency_cycles_sum{device=\"" << d.name << "\"} " << d.latencySum << "\n";
+				ss << "csopesy_io_latency_cycles_count{device=\"" << d.name << "\"} " << d.completed << "\n";
+			}
+		}
+
+		//latency of finished processes per scheduling mode
+		vector<string> modes = scheduler.latencyModes();
+		struct Latency {
+			const char* name;
+			const char* help;
+			LatencyHistogram LatencyStats::* field;
+		};
+		const Latency latencies[] = {
+			{"csopesy_turnaround_seconds", "Arrival to finish of finished processes.", &LatencyStats::turnaround},
+			{"csopesy_waiting_seconds", "Time finished processes spent in the ready queue.", &LatencyStats::waiting},
+			{"csopesy_response_seconds", "Arrival to first dispatch of finished processes.", &LatencyStats::response},
+		};
+		for(auto &latency : latencies) {
+			family(ss, latency.name, "histogram", latency.help);
+			for(auto &mode : modes) {
+				LatencyStats* stats = scheduler.getLatency(mode);
+				if(stats) histogram(ss, latency.name, mode, stats->*latency.field);
+			}
+		}
+		return ss.str();
+	}
+
+	/*
+	 * renders the metrics into path.tmp and renames it over path
+	 *
+	 * @returns bool - false if the file could not be written
+	 * */
+	bool writeOnce() {
+		string text = render();
+		string tmp = path + ".tmp";
+		{
+			ofstream out(tmp, ios::trunc);
+			if(!out.is_open() || !(out << text)) {
+				cerr << "[Error] Could not write " << tmp << endl;
+				return false;
+			}
+		}
+
+		error_code ec;
+		filesystem::rename(tmp, path, ec);
+		if(ec) {
+			cerr << "[Error] Could not rename " << tmp << ": " << ec.message() << endl;
+			return false;
+		}
+		writes++;
+		return true;
+	}
+
+	/*
+	 * @param path_ - file for the textfile collector, usually ending in .prom
+	 * @param intervalMs_ - time between two writes
+	 * */
+	void start(const string& path_, int intervalMs_) {
+		shutdown();
+		path = path_;
+		intervalMs = intervalMs_;
+		stop = false;
+		worker = thread([this]() { loop(); });
+	}
+
+	//writes one last time so the file holds the final numbers
+	void shutdown() {
+		{
+			lock_guard<mutex> lock(mtx);
+			if(stop) return;
+			stop = true;
+		}
+		cv.notify_all();
+		if(worker.joinable())
+			worker.join();
+		writeOnce();
+	}
+
+	bool isRunning() {
+		lock_guard<mutex> lock(mtx);
+		return !stop;
+	}
+	const string& getPath() const { return path; }
+	int getInterval() const { return intervalMs; }
+	uint64_t getWrites() const { return writes; }
+};
@@ -11,6 +11,13 @@ struct Log {
 		instr = instr_;
 	}
 
+	//rebuilds a log from its binary record
+	Log(const LogRecord& rec) {
+		timestamp = rec.timestamp;
+		core = rec.core;
+		instr = interner.lookup(rec.msgId);
+	}
+
 	void print() {
 		//get timestamp adjusted to local time
 		char strTime[100];
@@ -44,103 +51,308 @@ struct Log {
 	}
 };
 
-class Process {
+/*
+ * a name a program uses, one slot per name
+ *
+ * until DECLARE, ADD or SUBTRACT sets it, its value is the name read as a
+ * number, 0 if it is not one
+ * */
+struct Variable {
+	string name;
+	int32_t value;
+	bool declared;
+};
+
+//a READ or WRITE the process is blocked on
+struct IoRequest {
+	string device;
+	uint32_t bytes;
+	bool write;
+};
+
+/*
+ * what process-smi shows of a process, copied while the process is held so
+ * it can be printed after the process has moved on or left the node. the
+ * logs stay in the sink, which outlives every process
+ * */
+struct ProcessInfo {
 	string name;
 	int pid;
+	int migrations;
+	int instructionPointer;
+	int instructionCount;
+	uint32_t lastRecord;
+
+	void writeLogs(ostream& out) const {
+		logSink.forEach(pid, lastRecord, [&](const LogRecord& rec) {
+			if(out)
+				out << Log(rec).toString();
+		});
+	}
+};
+
+class Process {
+	friend struct ProcessCodec;	// checkpoint.hpp reads and rebuilds the private state
+
+	uint32_t nameId;	// interned, compared as an integer
+	int pid;
 	int instructionPointer;
 	int sleepTimer;
-	map<string, int> memory;
-	vector<Instruction> instructions;
-	vector<unique_ptr<Log>> logs;
-	mutex logMtx;
+	bool ioBlocked;		// ran READ or WRITE and waits for the device
+	vector<Variable> vars;
+	vector<PackedInstruction> code;	// walked front to back by the interpreter
+
+	//logs live in the log sink, the process only remembers where to look
+	atomic<uint32_t> logCount;
+	atomic<time_t> lastLog;
+	atomic<uint32_t> lastRecord;	// position of the newest record in the sink
+
+	//lifecycle timing, cycles come from the scheduler clock
+	int arrivalCycle;
+	int firstDispatchCycle;
+	int completionCycle;
+	SteadyClock::time_point arrivalTime;
+	SteadyClock::time_point firstDispatchTime;
+	SteadyClock::time_point completionTime;
+	uint64_t cpuNs;
+	bool arrived;
+	bool dispatched;
+
+	//placement, the core it last ran on and how often it changed cores
+	int lastCore;
+	int migrations;
+	SteadyClock::time_point readySince;
+
+#ifdef CSOPESY_COROUTINES
+	ProcessTask task;
+	ExecContext ctx;
+
+	/*
+	 * the process as a coroutine, state stays in the process itself so a
+	 * fresh coroutine can always pick up from the instruction pointer
+	 * */
+	ProcessTask run() {
+		while(hasRemainingInstructions()) {
+			if(code[instructionPointer].op == OP_SLEEP) {
+				int ticks = executeNextInstruction(*ctx.log);
+				ctx.executed++;
+				if(ticks > 0)
+					co_await ProcessTask::Pause{Suspend::Sleep};
+				continue;
+			}
+
+			executeNextInstruction(*ctx.log);
+			ctx.executed++;
+			if(ioBlocked) {
+				--ctx.budget;
+				co_await ProcessTask::Pause{Suspend::Io};
+				continue;
+			}
+			if(--ctx.budget <= 0)
+				co_await ProcessTask::Pause{Suspend::Preempt};
+			else if(--ctx.steps <= 0)
+				co_await ProcessTask::Pause{Suspend::Tick};
+		}
+	}
+#endif
+
+	//programs use a handful of names, so a scan beats a map here
+	int32_t findSlot(const string& key) const {
+		for(size_t i = 0; i < vars.size(); i++) {
+			if(vars[i].name == key) return i;
+		}
+		return -1;
+	}
+
+	/*
+	 * slot of a name, added on first use
+	 *
+	 * a number can name a variable too. instructions packed before that
+	 * name got its slot keep it as an immediate, which is still right since
+	 * they run before anything after them can set it
+	 * */
+	int32_t slot(const string& key) {
+		int32_t s = findSlot(key);
+		if(s >= 0) return s;
+		int32_t value;
+		try { value = stoi(key); } catch(...) { value = 0; }
+		vars.push_back({key, value, false});
+		return vars.size() - 1;
+	}
+
+	//a source operand, an immediate unless it is not a number or a variable of that name exists
+	void operand(const string& text, int32_t& field, uint8_t& kinds, uint8_t kind) {
+		int32_t s = findSlot(text);
+		if(s < 0 && parseImmediate(text, field)) return;
+		field = s >= 0 ? s : slot(text);
+		kinds |= kind;
+	}
+
+	int32_t read(int32_t field, uint8_t kinds, uint8_t kind) const {
+		return (kinds & kind) ? vars[field].value : field;
+	}
+
+	void store(int32_t s, int32_t value) {
+		vars[s].value = value;
+		vars[s].declared = true;
+	}
 
 public:
-	Process(int pid_, string name_) :
-		pid(pid),
-		name(name_),
+	Process(int pid_, const string& name_) :
+		nameId(interner.intern(name_)),
+		pid(pid_),
 		instructionPointer(0),
-		sleepTimer(0)
+		sleepTimer(0),
+		ioBlocked(false),
+		logCount(0),
+		lastLog(time(nullptr)),
+		lastRecord(LogSink::NO_RECORD),
+		arrivalCycle(0),
+		firstDispatchCycle(0),
+		completionCycle(0),
+		cpuNs(0),
+		arrived(false),
+		dispatched(false),
+		lastCore(-1),
+		migrations(0)
 	{}
 
 	Process() :
+		nameId(interner.intern("")),
+		pid(-1),
 		instructionPointer(0),
-		sleepTimer(0)
+		sleepTimer(0),
+		ioBlocked(false),
+		logCount(0),
+		lastLog(time(nullptr)),
+		lastRecord(LogSink::NO_RECORD),
+		arrivalCycle(0),
+		firstDispatchCycle(0),
+		completionCycle(0),
+		cpuNs(0),
+		arrived(false),
+		dispatched(false),
+		lastCore(-1),
+		migrations(0)
 	{}
 
-	void addInstruction(const Instruction &instr) {
-		instructions.push_back(instr);
+	void addInstruction(Instruction instr) {
+		if(instr.operation == "PRINT")
+			instr.msgId = interner.intern(instr.getOutput());
+		appendInstruction(instr);
+	}
+
+	//packs an instruction whose PRINT message is already interned
+	void appendInstruction(const Instruction& instr) {
+		const string& op = instr.operation;
+		const vector<string>& args = instr.arguments;
+		PackedInstruction packed{OP_NOP, 0, 0, 0, 0, 0};
+
+		if(op == "DECLARE" && args.size() >= 1) {
+			packed.op = OP_DECLARE;
+			packed.dst = slot(args[0]);
+			if(args.size() >= 2) operand(args[1], packed.a, packed.kinds, KIND_A_SLOT);
+		} else if((op == "ADD" || op == "SUBTRACT") && args.size() >= 3) {
+			packed.op = op == "ADD" ? OP_ADD : OP_SUBTRACT;
+			packed.dst = slot(args[0]);
+			operand(args[1], packed.a, packed.kinds, KIND_A_SLOT);
+			operand(args[2], packed.b, packed.kinds, KIND_B_SLOT);
+		} else if(op == "PRINT") {
+			packed.op = OP_PRINT;
+			packed.a = instr.msgId;
+		} else if(op == "SLEEP" && args.size() >= 1) {
+			packed.op = OP_SLEEP;
+			operand(args[0], packed.a, packed.kinds, KIND_A_SLOT);
+		} else if((op == "READ" || op == "WRITE") && args.size() >= 2) {
+			packed.op = op == "READ" ? OP_READ : OP_WRITE;
+			packed.a = slot(args[0]);
+			packed.kinds = KIND_A_SLOT;
+			operand(args[1], packed.b, packed.kinds, KIND_B_SLOT);
+		} else {
+			packed.a = slot(op);
+			packed.kinds = KIND_A_SLOT;
+		}
+		code.push_back(packed);
 	}
 
 	bool hasRemainingInstructions() {
-		return instructionPointer < instructions.size();
+		return instructionPointer < (int)code.size();
 	}
 
-   int getValue(const string& key) {
-      if (memory.find(key) != memory.end()) {
-         return memory[key];
-   	}
-      try {
-         return stoi(key); 
-      } catch (...) {
-         return 0; // Default to 0
-      }
-   }
+	int getValue(const string& key) {
+		int32_t s = findSlot(key);
+		if(s >= 0) return vars[s].value;
+		try {
+			return stoi(key);
+		} catch (...) {
+			return 0; // Default to 0
+		}
+	}
 
-   void setValue(const string& key, int value) {
-   	memory[key] = value; // <-- SAVES THE VALUE
-   }
+	void setValue(const string& key, int value) {
+		store(slot(key), value);
+	}
 
-	int executeNextInstruction(int core) {
+	int executeNextInstruction(LogCursor& log) {
 		if(!hasRemainingInstructions()) { return 0; }
-		
+
 		if(sleepTimer > 0) {
 			sleepTimer--;
 			return 1;
 		}
 
-        Instruction instr = instructions[instructionPointer];
-        
-        const string& op = instr.operation;
-        const vector<string>& args = instr.arguments;
-        
-        if (op == "DECLARE") {
-            if (args.size() >= 1) {
-                int initialValue = (args.size() >= 2) ? getValue(args[1]) : 0;
-                setValue(args[0], initialValue); 
-            }
-        } 
-        else if (op == "ADD") {
-            if (args.size() >= 3) {
-                int val2 = getValue(args[1]);
-                int val3 = getValue(args[2]);
-                int result = val2 + val3;
-                setValue(args[0], result);
-            }
-        }
-        else if (op == "SUBTRACT") {
-            if (args.size() >= 3) {
-                int val2 = getValue(args[1]);
-                int val3 = getValue(args[2]);
-                int result = val2 - val3;
-                setValue(args[0], result);
-            }
-        }
-        else if (op == "PRINT") {
-				logs.push_back(make_unique<Log>(core, instr.getOutput()));
-        }
-	
-			else if (op == "SLEEP") { 
-      		if (args.size() >= 1) {
-               sleepTimer = getValue(args[0]);
-					instructionPointer++;
-					return sleepTimer;
-   			}
-			}
-        
+		const PackedInstruction& instr = code[instructionPointer];
+		switch(instr.op) {
+		case OP_DECLARE:
+			store(instr.dst, read(instr.a, instr.kinds, KIND_A_SLOT));
+			break;
+		case OP_ADD:
+			store(instr.dst, read(instr.a, instr.kinds, KIND_A_SLOT) + read(instr.b, instr.kinds, KIND_B_SLOT));
+			break;
+		case OP_SUBTRACT:
+			store(instr.dst, read(instr.a, instr.kinds, KIND_A_SLOT) - read(instr.b, instr.kinds, KIND_B_SLOT));
+			break;
+		case OP_PRINT:
+			appendLog(log, instr.a);
+			break;
+		case OP_SLEEP:
+			sleepTimer = read(instr.a, instr.kinds, KIND_A_SLOT);
+			instructionPointer++;
+			return sleepTimer;
+		case OP_READ:
+		case OP_WRITE:
+			//the scheduler hands the process to the device once it leaves the core
+			ioBlocked = true;
+			break;
+		}
+
 		instructionPointer++;
 		return 0;
 	}
 
+#ifdef CSOPESY_COROUTINES
+	/*
+	 * resumes the process coroutine, creating it on first use
+	 *
+	 * @param log - log cursor of the core running it
+	 * @param budget - instructions left in the quantum, updated on return
+	 * @param steps - instructions to run before pausing for the core delay
+	 * @param executed - set to the number of instructions run
+	 * */
+	Suspend resume(LogCursor& log, int& budget, int steps, int& executed) {
+		if(!task) task = run();
+		ctx.log = &log;
+		ctx.budget = budget;
+		ctx.steps = steps;
+		ctx.executed = 0;
+
+		Suspend reason = task.resume();
+		budget = ctx.budget;
+		executed = ctx.executed;
+		return reason;
+	}
+#endif
+
 	void decSleepTimer() {
 		sleepTimer--;
 	}
@@ -149,34 +361,150 @@ public:
 		return sleepTimer;
 	}
 
+	//hot path of PRINT, only the owning core writes here
+	void appendLog(LogCursor& log, uint32_t msgId) {
+		time_t now = time(nullptr);
+		uint32_t seq = logCount.load(memory_order_relaxed) + 1;
+		uint32_t record = log.append(pid, msgId, seq, now, lastRecord.load(memory_order_relaxed));
+		if(record == LogSink::NO_RECORD) return;
+
+		lastRecord.store(record, memory_order_release);
+		logCount.store(seq, memory_order_release);
+		lastLog.store(now, memory_order_relaxed);
+	}
+
+	//streams the logs straight from the log sink
+	void writeLogs(ostream& out) {
+		forEachLog([&](const LogRecord& rec) {
+			if(out)
+				out << Log(rec).toString();
+		});
+	}
+
+	//every published PRINT record of this process, oldest first
+	template <typename Fn>
+	void forEachLog(Fn fn) {
+		logSink.forEach(pid, lastRecord.load(memory_order_acquire), fn);
+	}
+
 	void printLogs() {
-		lock_guard<mutex> lock(logMtx);
 		cout << "ID: " << pid << endl;
 		cout << "Logs:" << endl;
-		for(const auto& log : logs) {
-			log->print();
-		}
+		writeLogs(cout);
 	}
 
 	string toStringRecentTimeLog() {
-		lock_guard<mutex> lock(logMtx);
-		return logs.back()->toStringTimestamp();
+		Log recent(-1, "");
+		recent.timestamp = lastLog.load(memory_order_relaxed);
+		return recent.toStringTimestamp();
 	}
 
 	string toStringLogs() {
-		lock_guard<mutex> lock(logMtx);
-		string result;
-		for(const auto& log : logs) {
-			result += log->toString();
+		stringstream ss;
+		writeLogs(ss);
+		return ss.str();
+	}
+
+	//only the first call counts, requeues after a quantum are not arrivals
+	void markArrival(int cycle, SteadyClock::time_point at = SteadyClock::now()) {
+		if(arrived) return;
+		arrived = true;
+		arrivalCycle = cycle;
+		arrivalTime = at;
+		readySince = arrivalTime;
+	}
+
+	//entered the ready queue again after a quantum
+	void markReady() { readySince = SteadyClock::now(); }
+
+	/*
+	 * records the core the process is dispatched to
+	 *
+	 * @returns bool - true if it last ran on a different core
+	 * */
+	bool moveTo(int core) {
+		bool migrated = lastCore >= 0 && lastCore != core;
+		if(migrated) migrations++;
+		lastCore = core;
+		return migrated;
+	}
+
+	void markDispatch(int cycle) {
+		if(dispatched) return;
+		dispatched = true;
+		firstDispatchCycle = cycle;
+		firstDispatchTime = SteadyClock::now();
+	}
+
+	void markCompletion(int cycle) {
+		completionCycle = cycle;
+		completionTime = SteadyClock::now();
+	}
+
+	void addCpuTime(uint64_t ns) { cpuNs += ns; }
+
+	uint64_t getTurnaroundUs() {
+		return chrono::duration_cast<chrono::microseconds>(completionTime - arrivalTime).count();
+	}
+
+	uint64_t getResponseUs() {
+		return chrono::duration_cast<chrono::microseconds>(firstDispatchTime - arrivalTime).count();
+	}
+
+	//time spent runnable but not on a core
+	uint64_t getWaitingUs() {
+		uint64_t turnaround = getTurnaroundUs();
+		uint64_t cpuUs = cpuNs / 1000;
+		return turnaround > cpuUs ? turnaround - cpuUs : 0;
+	}
+
+	int getArrivalCycle() { return arrivalCycle; }
+	int getFirstDispatchCycle() { return firstDispatchCycle; }
+	int getCompletionCycle() { return completionCycle; }
+	int getLastCore() { return lastCore; }
+	int getMigrations() { return migrations; }
+
+	ProcessInfo info() {
+		return {getName(), pid, migrations, getInstructionPointer(), getInstructionCount(),
+			lastRecord.load(memory_order_acquire)};
+	}
+
+	//how long it has been waiting in the ready queue
+	uint64_t getReadyWaitUs() {
+		return chrono::duration_cast<chrono::microseconds>(SteadyClock::now() - readySince).count();
+	}
+
+	//bytes of the packed program and its variable slots
+	size_t programBytes() {
+		size_t bytes = code.capacity() * sizeof(PackedInstruction) + vars.capacity() * sizeof(Variable);
+		for(auto &var : vars) {
+			if(var.name.capacity() > 15) bytes += var.name.capacity() + 1;
 		}
-		return result;
+		return bytes;
 	}
 
-	string getName() { return name; }
+	//approximate heap + object bytes held by this process
+	size_t footprint() {
+		//the name is interned and not counted here
+		return sizeof(Process) + programBytes();
+	}
+
+	int getLogCount() { return logCount.load(memory_order_acquire); }
+	const string& getName() const { return interner.lookup(nameId); }
+	uint32_t getNameId() const { return nameId; }
 	int getPid() { return pid; }
-	int getInstructionCount() { return instructions.size(); }
+	int getInstructionCount() { return code.size(); }
 	int getInstructionPointer() { return instructionPointer; }
 	bool isAsleep() { return sleepTimer > 0; }
+	bool isBlockedOnIo() { return ioBlocked; }
+
+	//the READ or WRITE that blocked the process, the one just executed
+	IoRequest getIoRequest() {
+		const PackedInstruction& instr = code[instructionPointer - 1];
+		return {vars[instr.a].name, (uint32_t)max(0, read(instr.b, instr.kinds, KIND_B_SLOT)), instr.op == OP_WRITE};
+	}
+
+	void completeIo() { ioBlocked = false; }
 };
 
 
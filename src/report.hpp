@@ -0,0 +1,208 @@
+#include <fstream>
+#include <filesystem>
+#include <condition_variable>
+#include <deque>
+
+/*
+ * one row of the utilization report
+ *
+ * running rows are copied out of the cores, finished rows only keep a
+ * pointer since finished processes are never touched again
+ * */
+struct ReportRow {
+	uint32_t nameId;	// resolved when the row is written
+	string timestamp;
+	int core;
+	int instrPointer;
+	int instrCount;
+};
+
+struct ReportSnapshot {
+	int coreCount = 0;
+	int activeCount = 0;
+	vector<ReportRow> running;
+	vector<Process*> finished;
+	string latency;
+	string admission;
+};
+
+/*
+ * what the top screen shows, copied out without logs or finished processes
+ * */
+struct TopCore {
+	int id;
+	bool parked;
+	int pid;
+	uint32_t nameId;
+	int instrPointer;
+	int instrCount;
+};
+
+struct TopProcess {
+	int pid;
+	uint32_t nameId;
+	string state;
+	int remaining;		// instructions left
+	uint64_t waitUs;	// time in the ready queue, 0 when not waiting
+};
+
+struct TopSnapshot {
+	int cycle = 0;
+	int coreCount = 0;
+	CounterTotals totals;
+	AdmissionStats admission;
+	size_t finished = 0;
+	vector<TopCore> cores;
+	vector<TopProcess> procs;
+};
+
+/*
+ * renders a snapshot into any stream, flushing every chunk rows so large
+ * finished lists never have to be held in memory as a single string
+ *
+ * @param out - destination stream
+ * @param snap - the snapshot to render
+ * @param chunk - number of rows to buffer before writing
+ * */
+void writeReport(ostream& out, ReportSnapshot& snap, size_t chunk = 512)
+{
+	string line(39, '-');
+	stringstream header;
+	header << "CPU utilization: " << (1.0*snap.activeCount/snap.coreCount*100) << "%\n";
+
+	string buffer = header.str();
+	buffer += "Cores used: " + to_string(snap.activeCount) + "\n";
+	buffer += "Cores available: " + to_string(snap.coreCount - snap.activeCount) + "\n\n";
+	buffer += line + "\n";
+
+	buffer += "Running processes:\n";
+	for(auto &row : snap.running) {
+		buffer += interner.lookup(row.nameId) + "\t" + row.timestamp + "\tCore: " + to_string(row.core)
+			+ "\t" + to_string(row.instrPointer) + " / " + to_string(row.instrCount) + "\n";
+	}
+
+	buffer += "Finished processes: \n";
+	out << buffer;
+	buffer.clear();
+
+	size_t rows = 0;
+	for(Process* proc : snap.finished) {
+		buffer += proc->getName() + "\t" + proc->toStringRecentTimeLog() + "\tFinished\t"
+			+ to_string(proc->getInstructionPointer()) + " / "
+			+ to_string(proc->getInstructionCount()) + "\n";
+
+		if(++rows % chunk == 0) {
+			out << buffer;
+			buffer.clear();
+			if(!out) return;	// cancelled or the file failed
+		}
+	}
+
+	buffer += line + "\n";
+	if(!snap.latency.empty())
+		buffer += "Latency (finished processes):\n" + snap.latency + line + "\n";
+	if(!snap.admission.empty())
+		buffer += "Queues:\n" + snap.admission + line + "\n";
+	out << buffer;
+	out.flush();
+}
+
+/*
+ * background writer for report-util
+ *
+ * snapshots are queued by the caller and written by a single worker thread
+ * into <path>.tmp, which is then renamed over <path> so readers never see a
+ * half written report. if a report for the same path is still pending the
+ * newer snapshot replaces it.
+ * */
+class ReportWriter {
+	struct Job {
+		string path;
+		ReportSnapshot snap;
+	};
+
+	deque<Job> jobs;
+	mutex mtx;
+	condition_variable cv;
+	condition_variable idle;
+	thread worker;
+	bool quit;
+	bool busy;
+
+public:
+	ReportWriter() :
+		quit(false),
+		busy(false)
+	{
+		worker = thread([this]() { loop(); });
+	}
+
+	~ReportWriter() {
+		{
+			lock_guard<mutex> lock(mtx);
+			quit = true;
+		}
+		cv.notify_all();
+		if(worker.joinable())
+			worker.join();
+	}
+
+	void submit(string path, ReportSnapshot snap) {
+		{
+			lock_guard<mutex> lock(mtx);
+			auto it = find_if(jobs.begin(), jobs.end(),
+				[&](const Job& j) { return j.path == path; });
+			if(it != jobs.end())
+				it->snap = move(snap);
+			else
+				jobs.push_back({path, move(snap)});
+		}
+		cv.notify_one();
+	}
+
+	//blocks until every queued report has been renamed into place
+	void waitIdle() {
+		unique_lock<mutex> lock(mtx);
+		idle.wait(lock, [this]() { return jobs.empty() && !busy; });
+	}
+
+private:
+	void loop() {
+		while(true) {
+			Job job;
+			{
+				unique_lock<mutex> lock(mtx);
+				cv.wait(lock, [this]() { return quit || !jobs.empty(); });
+				if(jobs.empty()) return;
+				job = move(jobs.front());
+				jobs.pop_front();
+				busy = true;
+			}
+
+			write(job);
+
+			{
+				lock_guard<mutex> lock(mtx);
+				busy = false;
+			}
+			idle.notify_all();
+		}
+	}
+
+	void write(Job& job) {
+		string tmp = job.path + ".tmp";
+		{
+			ofstream out(tmp, ios::trunc);
+			if(!out.is_open()) {
+				cerr << "[Error] Could not open " << tmp << endl;
+				return;
+			}
+			writeReport(out, job.snap);
+		}
+
+		error_code ec;
+		filesystem::rename(tmp, job.path, ec);
+		if(ec)
+			cerr << "[Error] Could not rename " << tmp << ": " << ec.message() << endl;
+	}
+};
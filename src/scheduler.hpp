@@ -1,343 +1,1738 @@
 
-struct Core {
+struct alignas(64) Core {
 	int id;
 	atomic<bool> active;
 	unique_ptr<Process> current;
-	thread worker;
+	int hostCpu = -1;	// host cpu the stepping thread is pinned to
 	mutex coreMtx;
-
-	Core(int cid) :
+	LogCursor log;
+	CoreCounters counters;
+	LatencyStats latency;
+	unique_ptr<TraceRing> trace;
+
+	//state machine, only touched by whoever steps the core
+	int sliceLeft = 0;
+	int stallLeft = 0;	// steps still paying for a migration
+	int waitLeft = 0;	// lockstep cycles left of delays_per_exec
+	int pid = -1;
+	bool idle = false;
+	bool asleep = false;
+	SteadyClock::time_point dispatchTime;
+	SteadyClock::time_point lastStep;
+	SteadyClock::time_point nextStep;
+
+	Core(int cid, const atomic<int>* clock, LogSink* sink = &logSink) :
 		id(cid),
-		active(false)
+		active(false),
+		log(cid, clock, sink)
 	{}
 };
 
 class Scheduler {
+	//how far past the head of the ready queue a core looks for its own processes
+	static constexpr size_t AFFINITY_WINDOW = 8;
+
 	vector<unique_ptr<Core>> cores;	
 	vector<unique_ptr<Process>> readyQueue;
 	vector<unique_ptr<Process>> finished;
 	vector<unique_ptr<Process>> sleepingQueue;
+	map<string, LatencyStats> modeLatency;
+	unique_ptr<TraceRing> queueTrace;	// written under mtx
 	mutex mtx;
 
-	//cfg
-	int coreCount;
-	string mode;
-	int quantum;
-	int cpuCycle;
+	//admission control, all under mtx
+	size_t resident;			// admitted and not finished yet
+	long long maxResident;
+	string admissionPolicy;
+	AdmissionStats admission;
+	SpillQueue spill;
+
+	//simulated devices, under mtx
+	IoSystem io;
+	IoMix ioMix;
+	string ioDevices;
+
+	//cfg, the atomics can change under running cores through reconfigure
+	atomic<int> coreCount;		// cores built and visible, never shrinks
+	atomic<int> coreTarget;		// num_cpu, cores at or above it drain and park
+	string mode;				// written under mtx
+	atomic<bool> roundRobin;
+	atomic<int> quantum;
+	atomic<int> cpuCycle;
 	int cpuCycleDelay;
-	int execDelay;
-	int batchFreq;
+	atomic<int> execDelay;
+	atomic<int> batchFreq;
 	int minIns;
 	int maxIns;
-	
-	//
-	int freq;
+	string execModel;
+	string execBackend;
+	int execWorkers;
+	int migrationCost;			// written under mtx
+	string cpuAffinity;
+	string cpuList;
+	vector<int> placement;
+	bool lockstep;				// clock_mode lockstep, fixed at start
+	atomic<int> cycleUs;
+
+	//lockstep clock, lanes step their cores in parallel between two barriers
+	unique_ptr<TreeBarrier> barrier;
+	atomic<bool> lockstepRun;	// latched by the barrier completion
+	atomic<int> cycleLimit;		// 0 runs until stopped
+	SteadyClock::time_point nextCycle;
+	int freq;					// cycles since the generator last admitted
+
+	//where generated processes come from, see isolateWorkload()
+	LogSink* sink;
+	atomic<int>* ids;
+	optional<uint64_t> seed;	// the global workload seed when empty
+	int generateLimit;			// 0 generates until stopped
+	vector<thread> workers;		// per core in threads mode, the pool otherwise
+	unique_ptr<atomic<bool>[]> workerRunning;	// threads mode, set until a core thread has drained
+	atomic<int> coresBuilt;
 	atomic<bool> stop;
+	thread clockThread;			// the wall clock, joined by stopScheduler
 	thread testThread;
 	atomic<bool> test;
+	atomic<int> autoReport;
+	mutex reconfigMtx;
+	thread watchThread;
+	atomic<bool> watching;
+
+	//checkpoint gate, stepping threads park between two steps while it is closed
+	atomic<bool> pauseRequested;
+	mutex gateMtx;
+	condition_variable gateCv;
+	int steppers;				// threads stepping cores, under gateMtx
+	int parked;					// of those, waiting at the gate
+	vector<CoreImage> restoredCores;	// picked up by buildCore after a restore
+	bool resumeTest;					// the restored checkpoint had the generator on
+
+	//declared last so pending reports finish before processes are freed
+	ReportWriter reports;
 
 public:
 	Scheduler() :
+		resident(0),
+		maxResident(0),
+		admissionPolicy("block"),
 		coreCount(0),
+		coreTarget(0),
 		mode("fcfs"),
+		roundRobin(false),
 		quantum(3),
 		execDelay(10),
 		cpuCycle(0),
-		cpuCycleDelay(100000),
+		cpuCycleDelay(100),
 		batchFreq(10),
 		minIns(5),
 		maxIns(10),
+		execModel("threads"),
+		execBackend("step"),
+		execWorkers(0),
+		migrationCost(0),
+		cpuAffinity("none"),
+		lockstep(false),
+		cycleUs(0),
+		lockstepRun(false),
+		cycleLimit(0),
 		freq(0),
+		sink(&logSink),
+		ids(&nextId),
+		generateLimit(0),
+		coresBuilt(0),
 		stop(false),
-		test(false)
+		test(false),
+		autoReport(0),
+		watching(false),
+		pauseRequested(false),
+		steppers(0),
+		parked(0),
+		resumeTest(false)
 	{}
 
+	~Scheduler() {
+		stopWatch();
+		stopTest();
+		if(!stop)
+			stopScheduler(false);
+		reports.waitIdle();
+	}
+
 	void configure(Config cfg) {
 		mode = cfg.scheduler;
+		roundRobin = mode == "rr";
 		quantum = cfg.quantumCycles;
 		execDelay = cfg.delayExec;
-		coreCount = cfg.numcpu;
+		coreTarget = cfg.numcpu;
 		batchFreq = cfg.batchFreq; 
 		minIns = cfg.minIns;
 		maxIns = cfg.maxIns;
+		execModel = cfg.execModel;
+		execBackend = cfg.execBackend;
+		execWorkers = cfg.execWorkers;
+		migrationCost = cfg.migrationCost;
+		cpuAffinity = cfg.cpuAffinity;
+		cpuList = cfg.cpuList;
+		maxResident = cfg.maxResident;
+		admissionPolicy = cfg.admissionPolicy;
+		ioDevices = cfg.ioDevices;
+		vector<IoDeviceSpec> devices;
+		if(!ioDevices.empty())
+			parseIoDevices(ioDevices, devices);
+		io.configure(devices);
+		ioMix.percent = cfg.ioMix;
+		ioMix.devices.clear();
+		for(auto &device : devices) ioMix.devices.push_back(device.name);
+		lockstep = cfg.clockMode == "lockstep";
+		cycleUs = cfg.cycleUs;
+
+		//the cores themselves are built by the threads that step them, see start().
+		//room for the most cores the exec model allows so reconfigure can add more
+		cores.resize(execModel == "pool" ? 16384 : 128);
+	}
 
-		cores.reserve(coreCount);
-		for(int i = 0; i < coreCount; i++) {
-			cores.emplace_back(make_unique<Core>(i));
+	/*
+	 * builds a core on the calling thread
+	 *
+	 * called after the thread is pinned so the first touch of the core's
+	 * counters, histograms and log cursor lands in memory local to the cpu
+	 * that keeps writing them
+	 * */
+	void buildCore(int i, int hostCpu) {
+		cores[i] = make_unique<Core>(i, &cpuCycle, sink);
+		cores[i]->hostCpu = hostCpu;
+		if(tracing) cores[i]->trace = make_unique<TraceRing>();
+		if(i < (int)restoredCores.size() && restoredCores[i].present)
+			applyCoreImage(*cores[i], restoredCores[i]);
+		coresBuilt.fetch_add(1, memory_order_release);
+	}
+
+	//hands a core what it had when the checkpoint was taken
+	void applyCoreImage(Core& core, CoreImage& image) {
+		for(size_t f = 0; f < CHECKPOINT_COUNTERS; f++) {
+			(core.counters.*coreCounterFields[f]).store(image.counters[f], memory_order_relaxed);
+		}
+		LatencyHistogram* hists[] = {&core.latency.turnaround, &core.latency.waiting, &core.latency.response};
+		for(int h = 0; h < 3; h++) {
+			hists[h]->restore(image.latency[h].buckets, image.latency[h].sum, image.latency[h].max);
+		}
+		if(image.current) {
+			core.current = move(image.current);
+			core.active = true;
+			core.pid = core.current->getPid();
+			core.asleep = core.current->isAsleep();
+			core.sliceLeft = image.sliceLeft;
+			core.stallLeft = image.stallLeft;
+			core.waitLeft = image.waitLeft;
+			core.dispatchTime = SteadyClock::now();
+		}
+		image = CoreImage();
+	}
+
+	//stepping threads check in and out so a checkpoint knows whom to wait for
+	void joinGate() {
+		lock_guard<mutex> lock(gateMtx);
+		steppers++;
+	}
+
+	void leaveGate() {
+		{
+			lock_guard<mutex> lock(gateMtx);
+			steppers--;
 		}
+		gateCv.notify_all();
+	}
+
+	//called between steps, parks the thread while a checkpoint copies the cores
+	void gate() {
+		if(!pauseRequested.load(memory_order_acquire)) return;
+		unique_lock<mutex> lock(gateMtx);
+		parked++;
+		gateCv.notify_all();
+		gateCv.wait(lock, [this]() { return !pauseRequested; });
+		parked--;
+	}
+
+	//returns once every stepping thread is parked at the gate
+	void pauseCores() {
+		unique_lock<mutex> lock(gateMtx);
+		pauseRequested = true;
+		gateCv.wait(lock, [this]() { return parked == steppers; });
+	}
+
+	void resumeCores() {
+		{
+			lock_guard<mutex> lock(gateMtx);
+			pauseRequested = false;
+		}
+		gateCv.notify_all();
+	}
+
+	//blocks until the first n cores are built, then makes them visible
+	void publishCores(int n) {
+		while(coresBuilt.load(memory_order_acquire) < n)
+			this_thread::yield();
+		if(n > coreCount)
+			coreCount.store(n, memory_order_release);
+	}
+
+	//cores other threads may look at, built ones only
+	vector<Core*> liveCores() {
+		vector<Core*> live;
+		int n = coreCount.load(memory_order_acquire);
+		for(int i = 0; i < n; i++) live.push_back(cores[i].get());
+		return live;
 	}
 
 	void addProcess(unique_ptr<Process> p) {
-		lock_guard<mutex> lock(mtx);
+		ProfiledLock lock(mtx, siteAdd);
+		p->markArrival(cpuCycle);
+		traceEvent(queueTrace, TRACE_ARRIVE, 'i', p->getPid());
 		readyQueue.push_back(move(p));
+		resident++;
 	}
 
-	optional<unique_ptr<Process>> getNextProcess() {
-		lock_guard<mutex> lock(mtx);
+	/*
+	 * enqueues a batch under a single lock, used by bulk submission and
+	 * cluster migration
+	 *
+	 * past max_resident, drop rejects the rest of the batch and block waits
+	 * a cycle at a time for room. spill waits too, since a spill record can
+	 * only rebuild a generated program.
+	 *
+	 * @param cancel - ends the wait, whatever is left counts as dropped
+	 * @returns size_t - processes admitted, the rest of the batch was dropped
+	 * */
+	size_t addProcesses(vector<unique_ptr<Process>>& batch, const atomic<bool>& cancel) {
+		size_t next = 0;
+		while(true) {
+			{
+				ProfiledLock lock(mtx, siteAdd);
+				int cycle = cpuCycle;
+				size_t end = next + min(batch.size() - next, freeSlots());
+				for(; next < end; next++) {
+					Process& p = *batch[next];
+					p.markArrival(cycle);
+					traceEvent(queueTrace, TRACE_ARRIVE, 'i', p.getPid());
+					readyQueue.push_back(move(batch[next]));
+					resident++;
+				}
+				if(next == batch.size() || admissionPolicy == "drop" || stop || cancel) {
+					admission.dropped += batch.size() - next;
+					break;
+				}
+			}
+			this_thread::sleep_for(chrono::milliseconds(cpuCycleDelay));
+		}
+		batch.clear();
+		return next;
+	}
+
+	//processes addProcesses takes before max_resident, SIZE_MAX without one
+	size_t residentRoom() {
+		ProfiledLock lock(mtx, siteStats);
+		return freeSlots();
+	}
+
+	/*
+	 * hands up to n ready processes to another cluster node, taken from the
+	 * back of the queue where they would have waited longest here
+	 * */
+	vector<unique_ptr<Process>> takeReady(size_t n) {
+		ProfiledLock lock(mtx, siteCluster);
+		n = min(n, readyQueue.size());
+		vector<unique_ptr<Process>> taken;
+		taken.reserve(n);
+		for(size_t i = 0; i < n; i++) {
+			taken.push_back(move(readyQueue.back()));
+			readyQueue.pop_back();
+		}
+		resident -= n;
+		return taken;
+	}
+
+	/*
+	 * lets the generator create its next process if there is room
+	 *
+	 * called under mtx. a spilled backlog keeps new arrivals spilling too so
+	 * they are still admitted in arrival order
+	 *
+	 * @returns bool - false if the generator has to wait
+	 * */
+	bool admitGenerated() {
+		if(generateLimit > 0 && ids->load() >= generateLimit) return true;
+		bool full = maxResident > 0 && (long long)resident >= maxResident;
+		if(admissionPolicy == "spill" && (full || !spill.empty())) {
+			SpillRecord rec{ids->fetch_add(1), cpuCycle,
+				chrono::duration_cast<chrono::nanoseconds>(SteadyClock::now().time_since_epoch()).count()};
+			if(spill.push(rec))
+				admission.spilled++;
+			else
+				admission.dropped++;
+			return true;
+		}
+		if(full && admissionPolicy == "drop") {
+			admission.dropped++;
+			return true;
+		}
+		if(full) {
+			admission.blocked++;
+			return false;
+		}
+
+		int pid = ids->fetch_add(1);
+		unique_ptr<Process> proc = buildRandomProcess(pid, "PROC-" + to_string(pid), generatorSeed(), minIns, maxIns, ioMix);
+		proc->markArrival(cpuCycle);
+		traceEvent(queueTrace, TRACE_ARRIVE, 'i', proc->getPid());
+		readyQueue.push_back(move(proc));
+		resident++;
+		admission.admitted++;
+		return true;
+	}
+
+	uint64_t generatorSeed() const { return seed.value_or(workloadSeed); }
+
+	//room left under max_resident, called under mtx
+	size_t freeSlots() const {
+		if(maxResident <= 0) return SIZE_MAX;
+		return (long long)resident < maxResident ? maxResident - resident : 0;
+	}
+
+	/*
+	 * gives this scheduler a workload of its own, called before start()
+	 *
+	 * pids count up from ids_, programs come from seed_ and PRINT records go
+	 * to sink_, so several schedulers can replay the same workload side by
+	 * side without touching the emulator's processes or logs
+	 *
+	 * @param limit - processes to generate before the generator goes quiet
+	 * */
+	void isolateWorkload(LogSink& sink_, atomic<int>& ids_, uint64_t seed_, int limit) {
+		sink = &sink_;
+		ids = &ids_;
+		seed = seed_;
+		generateLimit = limit;
+	}
+
+	//rebuilds spilled processes while there is room, called under mtx
+	void refillSpilled() {
+		SpillRecord rec;
+		while((maxResident == 0 || (long long)resident < maxResident) && spill.pop(rec)) {
+			auto proc = buildRandomProcess(rec.pid, "PROC-" + to_string(rec.pid), generatorSeed(), minIns, maxIns, ioMix);
+			proc->markArrival(rec.arrivalCycle, SteadyClock::time_point(chrono::nanoseconds(rec.arrivalNs)));
+			traceEvent(queueTrace, TRACE_ARRIVE, 'i', proc->getPid());
+			readyQueue.push_back(move(proc));
+			resident++;
+			admission.refilled++;
+		}
+	}
+
+	AdmissionStats admissionStats() {
+		ProfiledLock lock(mtx, siteStats);
+		AdmissionStats a = admission;
+		a.resident = resident;
+		a.ready = readyQueue.size();
+		a.sleeping = sleepingQueue.size();
+		a.spillDepth = spill.size();
+		a.ioWaiting = io.waiting();
+		return a;
+	}
+
+	//queue depths and admission counters for the monitoring commands
+	string admissionSummary() {
+		AdmissionStats a = admissionStats();
+		long long limit;
+		string policy;
+		{
+			ProfiledLock lock(mtx, siteStats);
+			limit = maxResident;
+			policy = admissionPolicy;
+		}
+		stringstream ss;
+		ss << "resident: " << a.resident << " / " << (limit > 0 ? to_string(limit) : "unlimited")
+			<< "\tready: " << a.ready << "\tsleeping: " << a.sleeping
+			<< "\tio wait: " << a.ioWaiting << "\tspilled: " << a.spillDepth << "\n";
+		ss << "admission (" << policy << "): admitted " << a.admitted << "\tdropped " << a.dropped
+			<< "\tspilled " << a.spilled << "\trefilled " << a.refilled
+			<< "\tblocked ticks " << a.blocked << "\n";
+		return ss.str();
+	}
+
+	vector<IoDeviceStats> ioStats() {
+		ProfiledLock lock(mtx, siteStats);
+		return io.stats();
+	}
+
+	//queue depth and request latency per device, latencies in cycles
+	string ioSummary() {
+		vector<IoDeviceStats> devices = ioStats();
+		if(devices.empty())
+			return "no io devices, list them with io_devices in the config\n";
+
+		uint64_t cycles = max(1, cpuCycle.load());
+		stringstream ss;
+		ss << fixed << setprecision(1);
+		ss << "device\tlatency\tB/cycle\tdepth\tmax\treads\twrites\tkB done\tutil %\tmean\tp50\tp99\tmax\n";
+		for(auto &d : devices) {
+			ss << d.name << "\t" << d.latency << "\t" << d.bandwidth
+				<< "\t" << d.depth << "\t" << d.maxDepth
+				<< "\t" << d.reads << "\t" << d.writes << "\t" << d.bytes / 1024
+				<< "\t" << 100.0 * d.busyCycles / cycles
+				<< "\t" << (d.completed ? (double)d.latencySum / d.completed : 0.0)
+				<< "\t" << d.p50 << "\t" << d.p99 << "\t" << d.maxLatency << "\n";
+		}
+		return ss.str();
+	}
+
+	/*
+	 * picks the process a core should run next
+	 *
+	 * the queue is fifo, but under rr a core first looks a few entries past
+	 * the head for a process that last ran on it; fcfs never lets a later
+	 * process pass the head. a process from another core only
+	 * migrates here once that is worth migrationCost steps: while it has
+	 * waited less than that and its home core is idle, it is left for the
+	 * home core
+	 *
+	 * @param deferred - set when work was left for another core
+	 * @returns nullopt if nothing should run on this core now
+	 * */
+	optional<unique_ptr<Process>> getNextProcess(Core& core, bool& deferred) {
+		deferred = false;
+		auto waitStart = SteadyClock::now();
+		ProfiledLock lock(mtx, siteDispatch);
+		CoreCounters::add(core.counters.lockWaitNs, elapsedNs(waitStart));
 		if(readyQueue.empty()) return nullopt;
 
-		auto p = move(readyQueue.front());
-		readyQueue.erase(readyQueue.begin());
-		return p;
+		auto take = [this](size_t i) {
+			auto p = move(readyQueue[i]);
+			readyQueue.erase(readyQueue.begin() + i);
+			return p;
+		};
+
+		Process& front = *readyQueue.front();
+		int home = front.getLastCore();
+		if(migrationCost == 0 || home < 0 || home == core.id)
+			return take(0);
+
+		size_t window = roundRobin ? min(readyQueue.size(), AFFINITY_WINDOW) : 1;
+		for(size_t i = 1; i < window; i++) {
+			if(readyQueue[i]->getLastCore() == core.id)
+				return take(i);
+		}
+
+		uint64_t costUs = (uint64_t)migrationCost * max(1, execDelay.load()) * 1000;
+		//in lockstep an idle home core is dispatched in the same cycle
+		if(home < coreTarget && !cores[home]->active && (lockstep || front.getReadyWaitUs() < costUs)) {
+			deferred = true;
+			return nullopt;
+		}
+		return take(0);
+	}
+
+	/*
+	 * advances a core by one step of its state machine
+	 *
+	 * an idle core tries to dispatch, a busy core runs one instruction of its
+	 * slice and a core whose slice is over releases its process. the caller
+	 * decides how to wait, so the same step works for a dedicated thread and
+	 * for a pool worker multiplexing many cores.
+	 *
+	 * @returns milliseconds until the core wants to be stepped again
+	 * */
+	chrono::milliseconds stepCore(Core& core) {
+		CoreCounters& stats = core.counters;
+
+		//charge the time since the last step to whatever the core was doing
+		auto now = SteadyClock::now();
+		CoreCounters::add(core.active ? stats.busyNs : stats.idleNs,
+			chrono::duration_cast<chrono::nanoseconds>(now - core.lastStep).count());
+		core.lastStep = now;
+
+		if(!core.current) {
+			return dispatchCore(core);
+		}
+
+		//a core being drained hands its process back at the next step
+		if(core.id >= coreTarget) {
+			core.sliceLeft = 0;
+			core.stallLeft = 0;
+		}
+
+		//a migrated process warms up the new core before it makes progress
+		if(core.stallLeft > 0 && !stop) {
+			core.stallLeft--;
+			CoreCounters::add(stats.migrationStalls);
+			CoreCounters::add(stats.busyTicks);
+			return chrono::milliseconds(execDelay);
+		}
+
+#ifdef CSOPESY_COROUTINES
+		if(execBackend == "coroutine")
+			return resumeCore(core);
+#endif
+
+		if(core.sliceLeft > 0 && !stop && core.current->hasRemainingInstructions()) {
+			{
+				ProfiledLock lock(core.coreMtx, siteCoreExec);
+				if(core.current->executeNextInstruction(core.log)) {
+					CoreCounters::add(stats.sleeps);
+					if(!core.asleep) traceEvent(core.trace, TRACE_SLEEP, 'B', core.pid);
+					core.asleep = true;
+				} else {
+					CoreCounters::add(stats.instructions);
+					if(core.asleep) traceEvent(core.trace, TRACE_SLEEP, 'E', core.pid);
+					core.asleep = false;
+					core.sliceLeft--;
+				}
+			}
+			CoreCounters::add(stats.busyTicks);
+			//READ and WRITE give the core to other work until the device is done
+			if(core.current->isBlockedOnIo())
+				releaseCore(core);
+			return chrono::milliseconds(execDelay);
+		}
+
+		releaseCore(core);
+		return chrono::milliseconds(0);
+	}
+
+#ifdef CSOPESY_COROUTINES
+	/*
+	 * coroutine backend step, resumes the process until it pauses
+	 *
+	 * with no exec delay the whole quantum runs in one resume
+	 * */
+	chrono::milliseconds resumeCore(Core& core) {
+		CoreCounters& stats = core.counters;
+		Suspend reason = Suspend::Done;
+		int executed = 0;
+
+		if(!stop && core.sliceLeft > 0) {
+			ProfiledLock lock(core.coreMtx, siteCoreExec);
+			int steps = execDelay > 0 ? 1 : core.sliceLeft;
+			reason = core.current->resume(core.log, core.sliceLeft, steps, executed);
+		}
+		CoreCounters::add(stats.instructions, executed);
+		CoreCounters::add(stats.busyTicks, executed);
+
+		if(reason == Suspend::Tick)
+			return chrono::milliseconds(execDelay);
+		if(reason == Suspend::Sleep)
+			CoreCounters::add(stats.sleeps);
+
+		releaseCore(core);
+		return chrono::milliseconds(execDelay);
+	}
+#endif
+
+	chrono::milliseconds dispatchCore(Core& core) {
+		CoreCounters& stats = core.counters;
+		auto dispatchStart = SteadyClock::now();
+
+		bool deferred = false;
+		optional<unique_ptr<Process>> nextProc;
+		if(core.id < coreTarget)
+			nextProc = getNextProcess(core, deferred);
+		if(!nextProc.has_value()) {
+			if(!core.idle) {
+				traceEvent(core.trace, TRACE_IDLE, 'B');
+				core.idle = true;
+			}
+			CoreCounters::add(stats.idleTicks);
+			//work is queued but left for an idle core, look again shortly
+			return chrono::milliseconds(deferred ? max(1, execDelay.load()) : 50);
+		}
+
+		{
+			ProfiledLock lock(core.coreMtx, siteCoreDispatch);
+			core.active = true;
+			core.current = move(nextProc.value());
+			core.current->markDispatch(cpuCycle);
+			if(core.current->moveTo(core.id)) {
+				core.stallLeft = migrationCost;
+				CoreCounters::add(stats.migrations);
+			}
+
+			//for limiting instruction time, fcfs runs to completion
+			core.sliceLeft = roundRobin
+				? min(quantum.load(), core.current->getInstructionCount())
+				: core.current->getInstructionCount();
+		}
+		if(core.idle) {
+			traceEvent(core.trace, TRACE_IDLE, 'E');
+			core.idle = false;
+		}
+		core.pid = core.current->getPid();
+		core.asleep = false;
+		core.dispatchTime = dispatchStart;
+		traceEvent(core.trace, TRACE_SLICE, 'B', core.pid);
+		CoreCounters::add(stats.contextSwitches);
+		CoreCounters::add(stats.switchNs, elapsedNs(dispatchStart));
+		return chrono::milliseconds(0);
+	}
+
+	//puts the process back in the ready queue or retires it
+	void releaseCore(Core& core) {
+		CoreCounters& stats = core.counters;
+		auto releaseStart = SteadyClock::now();
+		{
+			ProfiledLock lock(core.coreMtx, siteCoreRelease);
+			auto waitStart = SteadyClock::now();
+			ProfiledLock lock2(mtx, siteRequeue);
+			CoreCounters::add(stats.lockWaitNs, elapsedNs(waitStart));
+			core.current->addCpuTime(elapsedNs(core.dispatchTime));
+			if(core.asleep) traceEvent(core.trace, TRACE_SLEEP, 'E', core.pid);
+			traceEvent(core.trace, TRACE_SLICE, 'E', core.pid);
+			if(core.current->isBlockedOnIo()) {
+				//READ or WRITE, tick() requeues it once the device is done
+				traceEvent(core.trace, TRACE_IO, 'i', core.pid);
+				unique_ptr<Process> undelivered = io.submit(move(core.current), cpuCycle);
+				if(undelivered) {
+					undelivered->markReady();
+					readyQueue.push_back(move(undelivered));
+				}
+			} else if(core.current->isAsleep() && execBackend == "coroutine") {
+				//blocked on SLEEP, tick() wakes it up
+				traceEvent(core.trace, TRACE_SLEEP, 'i', core.pid);
+				sleepingQueue.push_back(move(core.current));
+			} else if(core.current->hasRemainingInstructions()) {
+				traceEvent(core.trace, TRACE_REQUEUE, 'i', core.pid);
+				core.current->markReady();
+				readyQueue.push_back(move(core.current));
+				CoreCounters::add(stats.quantumExpiries);
+			} else {
+				traceEvent(core.trace, TRACE_FINISH, 'i', core.pid);
+				resident--;
+				core.current->markCompletion(cpuCycle);
+				core.latency.record(*core.current);
+				modeLatency[mode].record(*core.current);
+				finished.push_back(move(core.current));
+			}
+
+			core.active = false;
+			core.asleep = false;
+		}
+		CoreCounters::add(stats.switchNs, elapsedNs(releaseStart));
 	}
 
 	void start() {
+		placement = placementOrder(cpuAffinity, cpuList);
+
+		if(lockstep) {
+			startLockstep();
+			return;
+		}
+		clockThread = thread([this]() { simulate(); });
+		if(execModel == "pool") {
+			startPool();
+			return;
+		}
+
 		//threads for each core
-		for(auto &core : cores) {
-			//thread(...) in the background it will run the instr/ worker in the bg
-			//[this, &core] a lambad capt list, states which vars to use inside thread funct.
-			core->worker = thread([this, &core]() {
-				while(!stop) {
-					auto nextProc = getNextProcess();	
-					if(nextProc.has_value()) {
-						{
-							lock_guard<mutex> lock(core->coreMtx);
-							core->active = true;
-							core->current = move(nextProc.value());
-						}
+		workers.resize(cores.size());
+		workerRunning.reset(new atomic<bool>[cores.size()]());
+		for(int i = 0; i < coreTarget; i++) {
+			startCoreThread(i);
+		}
+		publishCores(coreTarget);
+	}
 
-						//for limiting instruction time
-						int limit;
-						{
-							lock_guard<mutex> lock(core->coreMtx);
-							limit = (mode == "rr") 
-								? min(quantum, core->current->getInstructionCount()) 
-								: core->current->getInstructionCount();
-						}
-						
-						//fcfs implementation (this runs to completion) 
-						for(int i = 0; i < limit && !stop && mode == "fcfs"; i++) { 
-							{
-								lock_guard<mutex> lock(core->coreMtx); 
-								if(core->current->executeNextInstruction(core->id)) { 
-									i--; 
-								}; 
-							} 
-							this_thread::sleep_for(chrono::milliseconds(execDelay)); 
-						}							
-
-						for(int i = 0; i < limit && !stop && mode == "rr"; i++) {
-							{
-								lock_guard<mutex> lock(core->coreMtx);
-								if(core->current->executeNextInstruction(core->id)) {
-									i--;
-								} 
-							}
-							this_thread::sleep_for(chrono::milliseconds(execDelay));
-						}
+	/*
+	 * the thread of one core in threads mode, builds the core on first start
+	 * and returns once the core is drained
+	 *
+	 * a thread still draining when num_cpu grows back keeps running instead,
+	 * so only a thread that has given up its running flag is ever joined
+	 * */
+	void startCoreThread(int i) {
+		if(workerRunning[i].exchange(true))
+			return;
+		if(workers[i].joinable())
+			workers[i].join();
+
+		int hostCpu = placement.empty() ? -1 : placement[i % placement.size()];
+		//thread(...) in the background it will run the instr/ worker in the bg
+		//[this, i, hostCpu] a lambad capt list, states which vars to use inside thread funct.
+		workers[i] = thread([this, i, hostCpu]() {
+			joinGate();
+			bool pinned = hostCpu >= 0 && pinThread(hostCpu);
+			if(!cores[i])
+				buildCore(i, pinned ? hostCpu : -1);
+			Core& core = *cores[i];
+			core.lastStep = SteadyClock::now();
+			while(true) {
+				while(!stop && (core.id < coreTarget || core.current)) {
+					gate();
+					auto delay = stepCore(core);
+					if(delay.count() > 0)
+						this_thread::sleep_for(delay);
+				}
+				//num_cpu may have grown again after the loop gave up
+				workerRunning[i] = false;
+				bool parked = false;
+				if(stop || core.id >= coreTarget || !workerRunning[i].compare_exchange_strong(parked, true))
+					break;
+			}
+			leaveGate();
+		});
+		//end of thread
+	}
 
-						{
-							lock_guard<mutex> lock(core->coreMtx);
-							lock_guard<mutex> lock2(mtx);
-							if(core->current->hasRemainingInstructions())
-								readyQueue.push_back(move(core->current));
-							else
-								finished.push_back(move(core->current));
+	/*
+	 * M:N execution, a fixed pool of host threads steps every simulated core
+	 *
+	 * worker w owns the cores whose id % workers == w, builds them when
+	 * num_cpu first reaches them and steps each one once it is due, then
+	 * sleeps until the earliest core wants to run again. parked cores above
+	 * num_cpu are only stepped until they hand back their process.
+	 * */
+	void startPool() {
+		int workerCount = execWorkers > 0 ? execWorkers : max(1u, thread::hardware_concurrency());
+		workerCount = min(workerCount, (int)cores.size());
+
+		for(int w = 0; w < workerCount; w++) {
+			int hostCpu = placement.empty() ? -1 : placement[w % placement.size()];
+			workers.emplace_back([this, w, workerCount, hostCpu]() {
+				joinGate();
+				bool pinned = hostCpu >= 0 && pinThread(hostCpu);
+				int built = w;	// next core of this worker that does not exist yet
 
-							core->active = false;
-						}
+				while(!stop) {
+					gate();
+					auto now = SteadyClock::now();
+					for(; built < coreTarget; built += workerCount) {
+						buildCore(built, pinned ? hostCpu : -1);
+						cores[built]->lastStep = now;
+						cores[built]->nextStep = now;
+					}
 
-					} else {
-						this_thread::sleep_for(chrono::milliseconds(50));
+					auto wake = now + chrono::milliseconds(50);
+					for(int i = w; i < built && !stop; i += workerCount) {
+						Core& core = *cores[i];
+						if(i >= coreTarget && !core.current) continue;
+						auto now = SteadyClock::now();
+						if(core.nextStep <= now)
+							core.nextStep = now + stepCore(core);
+						wake = min(wake, core.nextStep);
 					}
-				} 
+					this_thread::sleep_until(wake);
+				}
+				leaveGate();
 			});
-			//end of thread
 		}
+		publishCores(coreTarget);
 	}
 
-	void stopScheduler() {
+	/*
+	 * lockstep clock, every core advances exactly one cycle per barrier phase
+	 *
+	 * one lane per core in threads mode and one per pool worker otherwise,
+	 * lane l steps the cores whose id % lanes == l. the last lane to arrive
+	 * does nothing special, the barrier's root runs completeCycle() alone
+	 * while all cores are at rest, so releases, dispatches, the sleeping
+	 * queue and the generator happen in core id order every cycle and a run
+	 * does not depend on how the host schedules the lanes.
+	 * */
+	void startLockstep() {
+		int lanes = coreTarget;
+		if(execModel == "pool")
+			lanes = execWorkers > 0 ? execWorkers : max(1u, thread::hardware_concurrency());
+		lanes = max(1, min(lanes, (int)cores.size()));
+		barrier = make_unique<TreeBarrier>(lanes);
+		lockstepRun = true;
+		nextCycle = SteadyClock::now();
+
+		for(int l = 0; l < lanes; l++) {
+			int hostCpu = placement.empty() ? -1 : placement[l % placement.size()];
+			workers.emplace_back([this, l, lanes, hostCpu]() {
+				//only the root parks for a checkpoint, the others are held by the barrier
+				if(l == 0) joinGate();
+				bool pinned = hostCpu >= 0 && pinThread(hostCpu);
+				bool sense = false;
+				int built = l;
+
+				while(lockstepRun.load(memory_order_acquire)) {
+					for(; built < coreTarget; built += lanes) {
+						buildCore(built, pinned ? hostCpu : -1);
+					}
+					for(int i = l; i < built; i += lanes) {
+						advanceCore(*cores[i]);
+					}
+					barrier->arrive(l, sense, [this]() { completeCycle(); });
+				}
+				if(l == 0) leaveGate();
+			});
+		}
+		publishCores(coreTarget);
+	}
+
+	/*
+	 * the parallel half of a lockstep cycle, touches nothing but the core
+	 *
+	 * a busy cycle pays a migration stall, a delays_per_exec wait or runs one
+	 * instruction, where a step of SLEEP counts as the instruction. releasing
+	 * and dispatching is left to completeCycle().
+	 * */
+	void advanceCore(Core& core) {
+		CoreCounters& stats = core.counters;
+		if(!core.current) return;	// its idle cycle was counted by the failed dispatch
+		CoreCounters::add(stats.busyTicks);
+
+		if(core.stallLeft > 0) {
+			core.stallLeft--;
+			CoreCounters::add(stats.migrationStalls);
+			return;
+		}
+		if(core.waitLeft > 0) {
+			core.waitLeft--;
+			return;
+		}
+		if(core.id >= coreTarget || core.sliceLeft <= 0 || !core.current->hasRemainingInstructions())
+			return;
+
+		ProfiledLock lock(core.coreMtx, siteCoreExec);
+#ifdef CSOPESY_COROUTINES
+		if(execBackend == "coroutine") {
+			int executed = 0;
+			Suspend reason = core.current->resume(core.log, core.sliceLeft, 1, executed);
+			CoreCounters::add(stats.instructions, executed);
+			if(reason == Suspend::Sleep)
+				CoreCounters::add(stats.sleeps);
+			else
+				core.waitLeft = execDelay;
+			return;
+		}
+#endif
+		if(core.current->executeNextInstruction(core.log)) {
+			CoreCounters::add(stats.sleeps);
+			if(!core.asleep) traceEvent(core.trace, TRACE_SLEEP, 'B', core.pid);
+			core.asleep = true;
+		} else {
+			CoreCounters::add(stats.instructions);
+			if(core.asleep) traceEvent(core.trace, TRACE_SLEEP, 'E', core.pid);
+			core.asleep = false;
+			core.sliceLeft--;
+			core.waitLeft = execDelay;
+		}
+	}
+
+	//the serial half of a lockstep cycle, runs on the barrier's root
+	void completeCycle() {
+		int target = coreTarget;
+		for(int i = 0; i < (int)cores.size() && (i < target || cores[i]); i++) {
+			Core* core = cores[i].get();
+			if(!core || !core->current) continue;
+			bool blocked = core->current->isBlockedOnIo() ||
+				(execBackend == "coroutine" && core->current->isAsleep());
+			bool over = core->sliceLeft <= 0 || !core->current->hasRemainingInstructions();
+			if(i >= target || stop || blocked || (over && core->stallLeft == 0 && core->waitLeft == 0))
+				releaseCore(*core);
+		}
+
+		cpuCycle++;
+		tick();
+		if(test && ++freq >= batchFreq) {
+			ProfiledLock lock(mtx, siteGenerator);
+			if(admitGenerated())
+				freq = 0;
+		}
+
+		for(int i = 0; i < target && !stop; i++) {
+			Core* core = cores[i].get();
+			if(!core || core->current) continue;
+			dispatchCore(*core);
+			core->waitLeft = 0;
+		}
+
+		if(autoReport > 0 && cpuCycle % autoReport == 0)
+			requestReport();
+		gate();
+
+		if(cycleUs > 0) {
+			nextCycle = max(nextCycle + chrono::microseconds(cycleUs), SteadyClock::now() - chrono::milliseconds(100));
+			this_thread::sleep_until(nextCycle);
+		}
+		int limit = cycleLimit;
+		lockstepRun.store(!stop && (limit == 0 || cpuCycle < limit), memory_order_release);
+	}
+
+	//lockstep only, the clock stops by itself once cpuCycle reaches cycles
+	void setCycleLimit(int cycles) { cycleLimit = cycles; }
+
+	void stopScheduler(bool verbose = true) {
 		stop = true;
-		for(auto &core : cores) {
-			if(core->worker.joinable())
-				core->worker.join();
+		if(clockThread.joinable())
+			clockThread.join();
+		for(auto &worker : workers) {
+			if(worker.joinable())
+				worker.join();
 		}
-		cout << "All cores stopped." << endl;
+		if(verbose)
+			cout << "All cores stopped." << endl;
 	}
 
-	void state() {
-		struct CoreSnapshot{
-			//core snap
-			int id;
-			bool active;
-			//proc snap
-			string name;
-			int instrPointer;
-			int instrCount;
-			string logs;
-		};
+	int getCycle() { return cpuCycle; }
+	int getCoreCount() { return coreTarget; }
 
-		int activeCount = 0;
-		vector<CoreSnapshot> coreSnapshot;
+	string getMode() {
+		ProfiledLock lock(mtx, siteStats);
+		return mode;
+	}
 
-		//snapshots the cores/ running processes
-		for(auto &core : cores) {
-			//temporary values to store threaded core
-			int id = -1;
-			bool isActive = false;
-			Process* proc;
-			{
-				lock_guard<mutex> lock(core->coreMtx);
-				id = core->id;
-				isActive = core->active;
-				if(isActive && core->current)
-					proc = core->current.get();
-			}
-			if(core->active) {
-				coreSnapshot.push_back({
-						core->id, 
-						true, 
-						proc->getName(),
-						proc->getInstructionPointer(),
-						proc->getInstructionCount(),
-						proc->toStringRecentTimeLog()});
-				activeCount++;
-			}
+	int getQuantum() { return quantum; }
+	int getExecDelay() { return execDelay; }
+
+	size_t getFinishedCount() {
+		ProfiledLock lock(mtx, siteStats);
+		return finished.size();
+	}
+
+	//arrival and completion cycle of every finished process, in finishing order
+	vector<pair<int, int>> finishedCycles() {
+		ProfiledLock lock(mtx, siteStats);
+		vector<pair<int, int>> cycles;
+		cycles.reserve(finished.size());
+		for(auto &p : finished) {
+			cycles.push_back({p->getArrivalCycle(), p->getCompletionCycle()});
 		}
+		return cycles;
+	}
 
-		cout << "CPU utilization: " << (1.0*activeCount/coreCount*100) << "%" << endl;
-		cout << "Cores used: " << activeCount << endl;
-		cout << "Cores available: " << (coreCount - activeCount) << endl
-			<< endl;
-		
-		for (int i = 0; i <= 38; i++) { cout << "-"; }
-		cout << endl;
-		//running processes
-		cout << "Running processes:" << endl;
-		for(auto &core : coreSnapshot) {
-			cout << core.name << "\t" 
-				<< core.logs << "\tCore: " 
-				<< core.id << "\t"
-				<< core.instrPointer << " / " 
-				<< core.instrCount << endl;
+	size_t getReadyCount() {
+		ProfiledLock lock(mtx, siteStats);
+		return readyQueue.size();
+	}
+
+	//histograms of a mode, nullptr until a process finished under it
+	LatencyStats* getLatency(const string& name) {
+		ProfiledLock lock(mtx, siteStats);
+		auto it = modeLatency.find(name);
+		return it != modeLatency.end() ? &it->second : nullptr;
+	}
+
+	//modes that have latency histograms, in name order
+	vector<string> latencyModes() {
+		ProfiledLock lock(mtx, siteStats);
+		vector<string> names;
+		for(auto &entry : modeLatency) names.push_back(entry.first);
+		return names;
+	}
+
+	//copies out the running rows and the finished list for the report writer
+	ReportSnapshot snapshot() {
+		ReportSnapshot snap;
+		snap.coreCount = coreTarget;
+
+		for(Core* core : liveCores()) {
+			ProfiledLock lock(core->coreMtx, siteCoreSnapshot);
+			if(core->active && core->current) {
+				Process* proc = core->current.get();
+				snap.running.push_back({
+						proc->getNameId(),
+						proc->toStringRecentTimeLog(),
+						core->id,
+						proc->getInstructionPointer(),
+						proc->getInstructionCount()});
+				snap.activeCount++;
+			}
 		}
 
-		//finished processes
-		cout << "Finished processes: " << endl;
 		{
-			lock_guard<mutex> lock(mtx);
+			ProfiledLock lock(mtx, siteSnapshot);
+			snap.finished.reserve(finished.size());
 			for(auto &proc : finished) {
-				cout << proc->getName() << "\t"
-					<< proc->toStringRecentTimeLog() << "\tFinished\t" 
-					<< proc->getInstructionPointer() << " / "
-					<< proc->getInstructionCount() << endl;
+				snap.finished.push_back(proc.get());
+			}
+		}
 
+		return snap;
+	}
+
+	//cheap copy for the top screen, no logs and no finished processes
+	TopSnapshot topSnapshot() {
+		TopSnapshot snap;
+		snap.cycle = cpuCycle;
+		snap.coreCount = coreTarget;
+		snap.totals = totals();
+		snap.admission = admissionStats();
+
+		for(Core* core : liveCores()) {
+			ProfiledLock lock(core->coreMtx, siteCoreSnapshot);
+			TopCore row{core->id, core->id >= coreTarget, -1, 0, 0, 0};
+			if(core->current) {
+				Process* proc = core->current.get();
+				row.pid = proc->getPid();
+				row.nameId = proc->getNameId();
+				row.instrPointer = proc->getInstructionPointer();
+				row.instrCount = proc->getInstructionCount();
+				snap.procs.push_back({row.pid, row.nameId, "core " + to_string(core->id),
+					row.instrCount - row.instrPointer, 0});
 			}
+			snap.cores.push_back(row);
 		}
-		for (int i = 0; i <= 38; i++) { cout << "-"; }
-		cout << endl;
+
+		{
+			ProfiledLock lock(mtx, siteSnapshot);
+			snap.finished = finished.size();
+			snap.procs.reserve(snap.procs.size() + readyQueue.size() + sleepingQueue.size());
+			for(auto &proc : readyQueue) {
+				snap.procs.push_back({proc->getPid(), proc->getNameId(), "ready",
+					proc->getInstructionCount() - proc->getInstructionPointer(), proc->getReadyWaitUs()});
+			}
+			for(auto &proc : sleepingQueue) {
+				snap.procs.push_back({proc->getPid(), proc->getNameId(), "sleeping",
+					proc->getInstructionCount() - proc->getInstructionPointer(), 0});
+			}
+		}
+		return snap;
 	}
 
-	string reportUtil() {
-		
-		stringstream reportStream;
+	//sums the counters of every core, or only of one core when id >= 0
+	CounterTotals totals(int id = -1) {
+		CounterTotals t;
+		for(Core* core : liveCores()) {
+			if(id < 0 || core->id == id)
+				t.add(core->counters);
+		}
+		return t;
+	}
 
-		struct CoreSnapshot{
-			int id;
-			bool active;
-			string name;
-			int instrPointer;
-			int instrCount;
-			string logs;
-		};
+	/*
+	 * prints counters aggregated over a measuring window
+	 *
+	 * @param out - destination stream
+	 * @param windowMs - how long to sample before printing
+	 * */
+	void vmstat(ostream& out, int windowMs) {
+		vector<Core*> live = liveCores();
+		AdmissionStats admitBefore = admissionStats();
+		vector<CounterTotals> before;
+		for(Core* core : live) before.push_back(totals(core->id));
+		CounterTotals start = totals();
+
+		//sleeps in slices so a cancel ends the window early
+		auto until = SteadyClock::now() + chrono::milliseconds(windowMs);
+		while(!cancelRequested && SteadyClock::now() < until)
+			this_thread::sleep_for(min<SteadyClock::duration>(until - SteadyClock::now(), chrono::milliseconds(50)));
+
+		CounterTotals end = totals();
+		CounterTotals d = end - start;
+		double secs = end.seconds(start);
+
+		out << "cpu cycles: " << cpuCycle << endl;
+		out << "window: " << secs << "s" << endl;
+		out << "total ticks: " << (d.busyTicks + d.idleTicks)
+			<< "\tactive: " << d.busyTicks
+			<< "\tidle: " << d.idleTicks << endl;
+		out << "instructions: " << d.instructions
+			<< "\t(" << (secs > 0 ? d.instructions / secs : 0) << "/s)" << endl;
+		out << "sleep ticks: " << d.sleeps << endl;
+		out << "context switches: " << d.contextSwitches
+			<< "\tquantum expiries: " << d.quantumExpiries << endl;
+		out << "lock wait: " << d.lockWaitNs / 1000 << "us"
+			<< "\tswitch cost: " << (d.contextSwitches ? d.switchNs / d.contextSwitches : 0) << "ns" << endl;
+		out << "migrations: " << d.migrations
+			<< "\tmigration stall ticks: " << d.migrationStalls << endl;
+		out << "CPU utilization: " << d.utilization() << "%" << endl;
+		AdmissionStats admitAfter = admissionStats();
+		out << admissionSummary();
+		out << "drop rate: " << (secs > 0 ? (admitAfter.dropped - admitBefore.dropped) / secs : 0) << "/s"
+			<< "\tspill rate: " << (secs > 0 ? (admitAfter.spilled - admitBefore.spilled) / secs : 0) << "/s"
+			<< endl << endl;
+
+		out << "core\thost\tutil%\tinstr/s\tswitches\tmigrations" << endl;
+		for(size_t i = 0; i < live.size(); i++) {
+			CounterTotals c = totals(live[i]->id) - before[i];
+			out << live[i]->id
+				<< "\t" << (live[i]->hostCpu >= 0 ? to_string(live[i]->hostCpu) : "-")
+				<< "\t" << c.utilization()
+				<< "\t" << (secs > 0 ? c.instructions / secs : 0)
+				<< "\t" << c.contextSwitches
+				<< "\t" << c.migrations << endl;
+		}
+	}
 
-		int activeCount = 0;
-		vector<CoreSnapshot> coreSnapshot;
+	/*
+	 * latency percentiles of finished processes
+	 *
+	 * @param perCore - also break the numbers down per core
+	 * */
+	string latencySummary(bool perCore) {
+		string out = LatencyStats::header();
+		{
+			ProfiledLock lock(mtx, siteStats);
+			for(auto &[name, stats] : modeLatency) {
+				out += stats.summary(name);
+			}
+		}
+		if(perCore) {
+			for(Core* core : liveCores()) {
+				out += core->latency.summary("core" + to_string(core->id));
+			}
+		}
+		return out;
+	}
 
-		for(auto &core : cores) {
-			int id = -1;
-			bool isActive = false;
-			Process* proc = nullptr; 
+	//rings are allocated before the flag flips so cores never see a null ring
+	void setTracing(bool on) {
+		if(on) {
 			{
-				lock_guard<mutex> lock(core->coreMtx);
-				id = core->id;
-				isActive = core->active;
-				if(isActive && core->current)
-					proc = core->current.get();
+				ProfiledLock lock(mtx, siteTrace);
+				if(!queueTrace) queueTrace = make_unique<TraceRing>();
 			}
-			
-			if(isActive) { 
-				if (proc) {
-					coreSnapshot.push_back({
-							id, 
-							true, 
-							proc->getName(),
-							proc->getInstructionPointer(),
-							proc->getInstructionCount(),
-							proc->toStringRecentTimeLog()});
-					activeCount++;
+			for(Core* core : liveCores()) {
+				ProfiledLock lock(core->coreMtx, siteCoreTrace);
+				if(!core->trace) core->trace = make_unique<TraceRing>();
+			}
+		}
+		tracing.store(on, memory_order_release);
+	}
+
+	/*
+	 * converts the trace rings into chrome trace json
+	 *
+	 * @param path - output file
+	 * @returns bool - false if nothing was traced or the file failed
+	 * */
+	bool dumpTrace(const string& path) {
+		vector<pair<string, vector<TraceEvent>>> rings;
+		unordered_map<int, string> names;
+
+		for(Core* core : liveCores()) {
+			ProfiledLock lock(core->coreMtx, siteCoreTrace);
+			if(!core->trace) continue;	// built after tracing was turned on
+			rings.push_back({"Core " + to_string(core->id), core->trace->snapshot()});
+			if(core->current)
+				names[core->current->getPid()] = core->current->getName();
+		}
+
+		{
+			ProfiledLock lock(mtx, siteTrace);
+			if(!queueTrace) return false;
+			rings.push_back({"Scheduler", queueTrace->snapshot()});
+			for(auto *queue : {&readyQueue, &finished, &sleepingQueue}) {
+				for(auto &proc : *queue) {
+					names[proc->getPid()] = proc->getName();
 				}
 			}
 		}
 
-		reportStream << "CPU utilization: " << (1.0*activeCount/coreCount*100) << "%" << endl;
-		reportStream << "Cores used: " << activeCount << endl;
-		reportStream << "Cores available: " << (coreCount - activeCount) << endl
-					<< endl;
-		
-		for (int i = 0; i <= 38; i++) { reportStream << "-"; }
-		reportStream << endl;
-		
-		reportStream << "Running processes:" << endl;
-		for(auto &core : coreSnapshot) {
-			reportStream << core.name << "\t" 
-						<< core.logs << "\tCore: " 
-						<< core.id << "\t"
-						<< core.instrPointer << " / " 
-						<< core.instrCount << endl;
+		return writeChromeTrace(path, rings, names);
+	}
+
+	void state(ostream& out) {
+		ReportSnapshot snap = snapshot();
+		writeReport(out, snap);
+	}
+
+	/*
+	 * writes the whole scheduler to a checkpoint file
+	 *
+	 * the cores are parked between two steps only while the queues, the
+	 * processes on cores and the counters are copied. finished processes never
+	 * change again and are written once the cores run again, like the logs,
+	 * which are cut at what every process had published when it was copied.
+	 *
+	 * @param out - where the result is reported
+	 * @returns bool - false if the file could not be written
+	 * */
+	bool checkpoint(const string& path, ostream& out) {
+		lock_guard<mutex> guard(reconfigMtx);
+		array<CheckpointBuffer, CKPT_SECTIONS> sec;
+		ProcessCodec codec;
+		vector<Process*> done;
+		size_t live = 0;
+
+		auto pauseStart = SteadyClock::now();
+		pauseCores();
+		{
+			ProfiledLock lock(mtx, siteCheckpoint);
+			codec.now = SteadyClock::now();
+
+			stringstream cfg;
+			cfg << "num_cpu " << coreTarget << "\n"
+				<< "scheduler " << mode << "\n"
+				<< "quantum_cycles " << quantum << "\n"
+				<< "batch_process_freq " << batchFreq << "\n"
+				<< "min_ins " << minIns << "\n"
+				<< "max_ins " << maxIns << "\n"
+				<< "delays_per_exec " << execDelay << "\n"
+				<< "exec_model " << execModel << "\n"
+				<< "exec_backend " << execBackend << "\n"
+				<< "exec_workers " << execWorkers << "\n"
+				<< "migration_cost " << migrationCost << "\n"
+				<< "max_resident " << maxResident << "\n"
+				<< "admission_policy " << admissionPolicy << "\n"
+				<< "cpu_affinity " << cpuAffinity << "\n"
+				<< "clock_mode " << (lockstep ? "lockstep" : "wall") << "\n"
+				<< "cycle_us " << cycleUs << "\n"
+				<< "seed " << generatorSeed() << "\n"
+				<< "io_mix " << ioMix.percent << "\n";
+			if(!ioDevices.empty())
+				cfg << "io_devices " << ioDevices << "\n";
+			if(!cpuList.empty())
+				cfg << "cpu_list " << cpuList << "\n";
+			string text = cfg.str();
+			sec[CKPT_CONFIG].putBytes(text.data(), text.size());
+
+			vector<SpillRecord> backlog = spill.records();
+			int64_t nowNs = chrono::duration_cast<chrono::nanoseconds>(codec.now.time_since_epoch()).count();
+			CheckpointState state{cpuCycle, nextId, autoReport, test, admission.admitted, admission.dropped,
+				admission.spilled, admission.refilled, admission.blocked, backlog.size()};
+			sec[CKPT_STATE].put(state);
+			for(auto rec : backlog) {
+				rec.arrivalNs = nowNs - rec.arrivalNs;
+				sec[CKPT_STATE].put(rec);
+			}
+
+			for(auto &proc : readyQueue) codec.save(sec[CKPT_PROCESSES], *proc, CKPT_READY);
+			for(auto &proc : sleepingQueue) codec.save(sec[CKPT_PROCESSES], *proc, CKPT_SLEEPING);
+			io.forEach([&](Process& p) { codec.save(sec[CKPT_PROCESSES], p, CKPT_IO_WAIT); });
+			live = readyQueue.size() + sleepingQueue.size() + io.waiting();
+
+			vector<Core*> built = liveCores();
+			sec[CKPT_HISTOGRAMS].put<uint32_t>(modeLatency.size() + built.size());
+			sec[CKPT_HISTOGRAMS].put<uint32_t>(0);
+			auto histograms = [&](int core, const string& name, LatencyStats& stats) {
+				CheckpointBuffer& buf = sec[CKPT_HISTOGRAMS];
+				buf.put<int32_t>(core);
+				buf.put<uint32_t>(name.size());
+				buf.putBytes(name.data(), name.size());
+				buf.align();
+				buf.putHistogram(stats.turnaround);
+				buf.putHistogram(stats.waiting);
+				buf.putHistogram(stats.response);
+			};
+			for(auto &[name, stats] : modeLatency) histograms(-1, name, stats);
+
+			for(Core* core : built) {
+				CheckpointCore rec{core->id, core->sliceLeft, core->stallLeft, core->waitLeft, {}};
+				for(size_t f = 0; f < CHECKPOINT_COUNTERS; f++) {
+					rec.counters[f] = (core->counters.*coreCounterFields[f]).load(memory_order_relaxed);
+				}
+				sec[CKPT_CORES].put(rec);
+				histograms(core->id, "", core->latency);
+				if(core->current) {
+					codec.save(sec[CKPT_PROCESSES], *core->current, CKPT_ON_CORE, core->id);
+					live++;
+				}
+			}
+
+			done.reserve(finished.size());
+			for(auto &proc : finished) done.push_back(proc.get());
+		}
+		resumeCores();
+		uint64_t pausedUs = elapsedNs(pauseStart) / 1000;
+
+		for(Process* proc : done) codec.save(sec[CKPT_PROCESSES], *proc, CKPT_FINISHED);
+
+		//logs published by the saved processes, then the messages programs and logs refer to
+		uint64_t logs = 0;
+		logSink.forEachRecord([&](const LogRecord& rec) {
+			uint32_t seq = rec.seq.load(memory_order_acquire);
+			if(rec.pid < 0 || (size_t)rec.pid >= codec.logCounts.size() || seq > codec.logCounts[rec.pid])
+				return;
+			sec[CKPT_LOGS].put(CheckpointLog{rec.pid, rec.core, codec.message(rec.msgId), seq, rec.cycle, rec.timestamp});
+			logs++;
+		});
+		sec[CKPT_MESSAGES].putStrings(codec.messages);
+		sec[CKPT_STRINGS].putStrings(codec.strings);
+
+		uint64_t bytes = writeCheckpoint(path, sec);
+		if(bytes == 0) {
+			out << "could not write checkpoint " << path << endl;
+			return false;
+		}
+		out << fixed << setprecision(1)
+			<< "checkpoint " << path << ": " << live + done.size() << " processes ("
+			<< live << " live, " << done.size() << " finished), " << logs << " log records, "
+			<< bytes / 1048576.0 << " MB, cores paused " << pausedUs / 1000.0 << " ms" << endl;
+		return true;
+	}
+
+	/*
+	 * rebuilds the scheduler from a checkpoint, in place of configure
+	 *
+	 * the mapped file is checked completely before anything is applied, so
+	 * a bad file leaves the scheduler as it was. processes that were on a
+	 * core go back to that core once start() builds it.
+	 *
+	 * @param cfg - set to the configuration stored in the checkpoint
+	 * @param out - where the result is reported
+	 * */
+	bool restore(const string& path, Config& cfg, ostream& out) {
+		auto fail = [&](const string& why) {
+			out << "could not restore " << path << ": " << why << endl;
+			return false;
+		};
+
+		CheckpointFile file;
+		CheckpointHeader header;
+		array<CheckpointView, CKPT_SECTIONS> views;
+		if(!file.open(path)) return fail("cannot open the file");
+		string problem = file.sections(header, views);
+		if(!problem.empty()) return fail(problem);
+		auto base = [&](CheckpointSection s) { return file.data() + header.sections[s].offset; };
+
+		istringstream cfgText(string(base(CKPT_CONFIG), header.sections[CKPT_CONFIG].bytes).c_str());
+		if(!cfg.load(cfgText)) return fail("bad configuration");
+		size_t coreSlots = cfg.execModel == "pool" ? 16384 : 128;
+
+		CheckpointState state;
+		CheckpointView& stateView = views[CKPT_STATE];
+		if(!stateView.get(state) || state.nextId < 0 || state.nextId > numeric_limits<int>::max() ||
+			state.spillCount > header.sections[CKPT_STATE].bytes / sizeof(SpillRecord))
+			return fail("bad state");
+		vector<SpillRecord> backlog(state.spillCount);
+		for(auto &rec : backlog) {
+			if(!stateView.get(rec)) return fail("bad spill backlog");
+		}
+
+		vector<string> strings, messages;
+		if(!views[CKPT_STRINGS].getStrings(strings)) return fail("bad string table");
+		if(!views[CKPT_MESSAGES].getStrings(messages)) return fail("bad message table");
+		vector<uint32_t> messageIds;
+		messageIds.reserve(messages.size());
+		for(auto &msg : messages) messageIds.push_back(interner.intern(msg));
+
+		//processes, in queue order. a first pass finds where every record
+		//starts, then the processes are built on all host cpus at once
+		auto now = SteadyClock::now();
+		const char* procBase = base(CKPT_PROCESSES);
+		vector<pair<CheckpointProcess, const char*>> records;
+		CheckpointView procView = views[CKPT_PROCESSES];
+		while(!procView.done()) {
+			CheckpointProcess rec;
+			if(!procView.get(rec) || rec.pid < 0 || rec.pid >= state.nextId ||
+				rec.queue < CKPT_READY || rec.queue > CKPT_IO_WAIT ||
+				(rec.queue == CKPT_ON_CORE && (rec.core < 0 || (size_t)rec.core >= coreSlots)))
+				return fail("bad process record");
+			records.push_back({rec, procView.position()});
+			if(!ProcessCodec::skip(procView, procBase, rec))
+				return fail("bad process " + to_string(rec.pid));
 		}
 
-		reportStream << "Finished processes: " << endl;
+		vector<unique_ptr<Process>> procs(records.size());
+		atomic<bool> malformed(false);
+		size_t builders = min<size_t>(max(1u, thread::hardware_concurrency()), records.size() / 4096 + 1);
+		vector<thread> threads;
+		for(size_t t = 0; t < builders; t++) {
+			threads.emplace_back([&, t]() {
+				size_t from = records.size() * t / builders, to = records.size() * (t + 1) / builders;
+				for(size_t i = from; i < to && !malformed; i++) {
+					const char* at = records[i].second;
+					CheckpointView view(at, header.sections[CKPT_PROCESSES].bytes - (at - procBase));
+					procs[i] = ProcessCodec::load(view, procBase, records[i].first, strings, messageIds, now);
+					if(!procs[i]) malformed = true;
+				}
+			});
+		}
+		for(auto &t : threads) t.join();
+		if(malformed) return fail("bad process record");
+
+		vector<CoreImage> images(coreSlots);
+		CheckpointView& coreView = views[CKPT_CORES];
+		while(!coreView.done()) {
+			CheckpointCore rec;
+			if(!coreView.get(rec) || rec.id < 0 || (size_t)rec.id >= coreSlots) return fail("bad core record");
+			CoreImage& image = images[rec.id];
+			image.present = true;
+			image.sliceLeft = rec.sliceLeft;
+			image.stallLeft = rec.stallLeft;
+			image.waitLeft = rec.waitLeft;
+			copy(begin(rec.counters), end(rec.counters), image.counters.begin());
+		}
+
+		vector<pair<string, array<HistogramImage, 3>>> modeImages;
+		CheckpointView& histView = views[CKPT_HISTOGRAMS];
+		uint32_t histCount, pad;
+		if(!histView.get(histCount) || !histView.get(pad)) return fail("bad histograms");
+		for(uint32_t i = 0; i < histCount; i++) {
+			int32_t core;
+			uint32_t nameBytes;
+			const char* name;
+			array<HistogramImage, 3> hists;
+			if(!histView.get(core) || !histView.get(nameBytes) || !histView.bytes(nameBytes, name) ||
+				!histView.align(base(CKPT_HISTOGRAMS)) || (core >= 0 && (size_t)core >= coreSlots))
+				return fail("bad histograms");
+			for(auto &h : hists) {
+				if(!histView.getHistogram(h)) return fail("bad histograms");
+			}
+			if(core >= 0)
+				images[core].latency = move(hists);
+			else
+				modeImages.push_back({string(name, nameBytes), move(hists)});
+		}
+
+		//log records are checked here and copied straight from the mapping below
+		CheckpointView logView = views[CKPT_LOGS];
+		size_t logCount = 0;
+		for(CheckpointLog rec; !logView.done(); logCount++) {
+			if(!logView.get(rec) || rec.pid < 0 || rec.pid >= state.nextId || rec.msgId >= messageIds.size())
+				return fail("bad log record");
+		}
+
+		//everything checked, apply it
+		configure(cfg);
+		//keyed by pid, nextId comes from the file and says nothing about how many pids are used
+		unordered_map<int32_t, uint32_t> lastRecord;
+		LogCursor cursor(-1, nullptr);
+		size_t restoredLogs = 0;
+		logView = views[CKPT_LOGS];
+		for(CheckpointLog rec; logView.get(rec); ) {
+			uint32_t& last = lastRecord.try_emplace(rec.pid, LogSink::NO_RECORD).first->second;
+			uint32_t record = cursor.put(rec.pid, rec.core, messageIds[rec.msgId], rec.seq, rec.cycle, rec.timestamp, last);
+			if(record == LogSink::NO_RECORD) break;
+			last = record;
+			restoredLogs++;
+		}
+
+		size_t counts[5] = {};
 		{
-			lock_guard<mutex> lock(mtx);
-			for(auto &proc : finished) {
-				reportStream << proc->getName() << "\t"
-							<< proc->toStringRecentTimeLog() << "\tFinished\t" 
-							<< proc->getInstructionPointer() << " / "
-							<< proc->getInstructionCount() << endl;
+			ProfiledLock lock(mtx, siteCheckpoint);
+			for(size_t i = 0; i < procs.size(); i++) {
+				const CheckpointProcess& rec = records[i].first;
+				unique_ptr<Process>& proc = procs[i];
+				auto last = lastRecord.find(rec.pid);
+				if(last != lastRecord.end())
+					ProcessCodec::setLastRecord(*proc, last->second);
+				counts[rec.queue]++;
+				if(rec.queue == CKPT_FINISHED) {
+					finished.push_back(move(proc));
+					continue;
+				}
+				resident++;
+				if(rec.queue == CKPT_SLEEPING) {
+					sleepingQueue.push_back(move(proc));
+				} else if(rec.queue == CKPT_IO_WAIT) {
+					//the request starts over on its device
+					proc = io.submit(move(proc), state.cpuCycle);
+					if(proc) readyQueue.push_back(move(proc));
+				}
+				else if(rec.queue == CKPT_ON_CORE && rec.core < coreTarget)
+					images[rec.core].current = move(proc);
+				else
+					readyQueue.push_back(move(proc));
+			}
 
+			for(auto &[name, hists] : modeImages) {
+				LatencyStats& stats = modeLatency[name];
+				stats.turnaround.restore(hists[0].buckets, hists[0].sum, hists[0].max);
+				stats.waiting.restore(hists[1].buckets, hists[1].sum, hists[1].max);
+				stats.response.restore(hists[2].buckets, hists[2].sum, hists[2].max);
 			}
+
+			int64_t nowNs = chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch()).count();
+			for(auto rec : backlog) {
+				rec.arrivalNs = nowNs - rec.arrivalNs;
+				spill.push(rec);
+			}
+			admission.admitted = state.admitted;
+			admission.dropped = state.dropped;
+			admission.spilled = state.spilled;
+			admission.refilled = state.refilled;
+			admission.blocked = state.blocked;
 		}
-		for (int i = 0; i <= 38; i++) { reportStream << "-"; }
-		reportStream << endl;
+		restoredCores = move(images);
+		cpuCycle = state.cpuCycle;
+		nextId = state.nextId;
+		autoReport = state.autoReport;
+
+		char taken[32];
+		time_t createdAt = header.createdAt;
+		strftime(taken, sizeof(taken), "%m/%d/%Y %I:%M:%S%p", localtime(&createdAt));
+		out << "restored " << procs.size() << " processes (" << counts[CKPT_READY] << " ready, "
+			<< counts[CKPT_SLEEPING] << " sleeping, " << counts[CKPT_IO_WAIT] << " waiting on io, "
+			<< counts[CKPT_ON_CORE] << " on cores, "
+			<< counts[CKPT_FINISHED] << " finished) and " << restoredLogs << " log records from "
+			<< path << ", taken " << taken << endl;
+		if(restoredLogs < logCount)
+			out << "the log sink is full, " << logCount - restoredLogs << " log records were dropped" << endl;
+
+		//the caller starts the generator once the workload seed is back
+		resumeTest = state.testing;
+		return true;
+	}
+
+	//whether the restored checkpoint was taken with the generator running
+	bool resumesTest() const { return resumeTest; }
+
+	//queues a report to be written in the background
+	void requestReport(string path = "csopesy-log.txt") {
+		ReportSnapshot snap = snapshot();
+		snap.latency = latencySummary(false);
+		snap.admission = admissionSummary();
+		reports.submit(path, move(snap));
+	}
+
+	void setAutoReport(int cycles) {
+		autoReport = cycles;
+	}
+
+	/*
+	 * applies a new config to the running scheduler
+	 *
+	 * quantum and delay take effect at the next dispatch and step, a mode
+	 * switch reorders the ready queue for the new policy, and num_cpu starts
+	 * new cores or drains the ones above it. drained cores hand their process
+	 * back to the ready queue and stay parked so their counters are kept.
+	 * keys that shape the threads themselves need a restart.
+	 *
+	 * @param out - where the changes are listed
+	 * */
+	void reconfigure(const Config& cfg, ostream& out) {
+		lock_guard<mutex> guard(reconfigMtx);
+
+		if(cfg.execModel != execModel || cfg.execBackend != execBackend ||
+			cfg.execWorkers != execWorkers || cfg.cpuAffinity != cpuAffinity || cfg.cpuList != cpuList ||
+			(cfg.clockMode == "lockstep") != lockstep || cfg.ioDevices != ioDevices)
+			out << "exec_model, exec_backend, exec_workers, cpu_affinity, clock_mode and io_devices need a restart, kept." << endl;
+
+		auto changed = [&out](const string& key, long long from, long long to) {
+			if(from != to)
+				out << key << ": " << from << " -> " << to << endl;
+		};
+		changed("quantum_cycles", quantum, cfg.quantumCycles);
+		quantum = cfg.quantumCycles;
+		changed("delays_per_exec", execDelay, cfg.delayExec);
+		execDelay = cfg.delayExec;
+		changed("batch_process_freq", batchFreq, cfg.batchFreq);
+		batchFreq = cfg.batchFreq;
+		changed("cycle_us", cycleUs, cfg.cycleUs);
+		cycleUs = cfg.cycleUs;
+
+		{
+			//the generator reads the instruction range under mtx
+			ProfiledLock lock(mtx, siteReconfigure);
+			::minIns = minIns = cfg.minIns;
+			::maxIns = maxIns = cfg.maxIns;
+			changed("migration_cost", migrationCost, cfg.migrationCost);
+			migrationCost = cfg.migrationCost;
+			changed("max_resident", maxResident, cfg.maxResident);
+			maxResident = cfg.maxResident;
+			if(cfg.admissionPolicy != admissionPolicy)
+				out << "admission_policy: " << admissionPolicy << " -> " << cfg.admissionPolicy << endl;
+			admissionPolicy = cfg.admissionPolicy;
+			//devices stay as they were, so io_mix cannot start using new ones
+			if(cfg.ioDevices == ioDevices) {
+				changed("io_mix", ioMix.percent, cfg.ioMix);
+				ioMix.percent = cfg.ioMix;
+			}
+
+			if(cfg.scheduler != mode) {
+				out << "scheduler: " << mode << " -> " << cfg.scheduler << endl;
+				mode = cfg.scheduler;
+				roundRobin = mode == "rr";
+				//fcfs serves in arrival order, rr left requeued processes at the back
+				if(mode == "fcfs") {
+					stable_sort(readyQueue.begin(), readyQueue.end(),
+						[](const unique_ptr<Process>& a, const unique_ptr<Process>& b) {
+							return make_pair(a->getArrivalCycle(), a->getPid())
+								< make_pair(b->getArrivalCycle(), b->getPid());
+						});
+				}
+			}
+		}
+
+		int target = min(cfg.numcpu, (int)cores.size());
+		if(target != coreTarget) {
+			out << "num_cpu: " << coreTarget << " -> " << target << endl;
+			int from = coreTarget;
+			coreTarget = target;
+			//lockstep lanes pick up new cores at the next cycle
+			if(execModel != "pool" && !lockstep) {
+				for(int i = from; i < target; i++) startCoreThread(i);
+			}
+			publishCores(target);
+		}
+	}
 
-		return reportStream.str();
+	/*
+	 * polls a config file and reconfigures whenever it is saved
+	 *
+	 * @param path - config file to watch
+	 * */
+	void watchConfig(const string& path) {
+		stopWatch();
+		watching = true;
+		watchThread = thread([this, path]() {
+			error_code ec;
+			auto seen = filesystem::last_write_time(path, ec);
+			while(watching) {
+				this_thread::sleep_for(chrono::milliseconds(500));
+				auto now = filesystem::last_write_time(path, ec);
+				if(ec || now == seen) continue;
+				seen = now;
+
+				Config cfg;
+				if(cfg.loadFile(path)) {
+					stringstream out;
+					out << "\n" << path << " changed, reconfiguring" << endl;
+					reconfigure(cfg, out);
+					consoleWrite(out.str());
+				}
+			}
+		});
 	}
 
+	void stopWatch() {
+		watching = false;
+		if(watchThread.joinable())
+			watchThread.join();
+	}
+
+	//counts down sleeping processes once per cpu cycle
 	void tick() {
-		lock_guard<mutex> lock(mtx);
-		for (int i = 0; i < sleepingQueue.size(); i++) {
+		ProfiledLock lock(mtx, siteTick);
+		refillSpilled();
+		for (size_t i = 0; i < sleepingQueue.size(); ) {
 			Process* p = sleepingQueue[i].get();
 			p->decSleepTimer();
 
 			if (p->getSleepTimer() <= 0) {
+				traceEvent(queueTrace, TRACE_REQUEUE, 'i', p->getPid());
+				p->markReady();
 				readyQueue.push_back(move(sleepingQueue[i]));
 				sleepingQueue.erase(sleepingQueue.begin() + i); // safe erase
 			} else {
 				i++; // only increment if we didn’t erase
 			}
 		}
+
+		io.complete(cpuCycle, [this](unique_ptr<Process> p) {
+			traceEvent(queueTrace, TRACE_IO, 'i', p->getPid());
+			p->markReady();
+			readyQueue.push_back(move(p));
+		});
 	}
 
+	//the wall clock thread, the lockstep clock is driven by the cores themselves
 	void simulate() {
 		while(!stop) {
 			cpuCycle++;
+			tick();
+			if(autoReport > 0 && cpuCycle % autoReport == 0)
+				requestReport();
 			this_thread::sleep_for(chrono::milliseconds(cpuCycleDelay));
 		}
 	}
 
-	void startTest() {
-		cout << "Test has started..." << endl;
+	void startTest(bool verbose = true) {
+		if(verbose)
+			cout << "Test has started..." << endl;
 		test = true;
+		//the lockstep generator runs in completeCycle()
+		if(lockstep) return;
 		testThread = thread([&]() {
 			int freq = 0;
 			while(test) {
 				freq++;
 				if(freq >= batchFreq) {
-					lock_guard<mutex> lock(mtx);
-					unique_ptr<Process> proc = createRandomProcess();
-					readyQueue.push_back(move(proc));
-					freq = 0;
+					ProfiledLock lock(mtx, siteGenerator);
+					//a blocked generator keeps retrying every tick
+					if(admitGenerated())
+						freq = 0;
 				}
 				this_thread::sleep_for(chrono::milliseconds(batchFreq));
 			}
@@ -350,86 +1745,56 @@ public:
 			testThread.join();
 	}
 
-	optional<Process*> searchProcess(string name) {
-		for(auto &core : cores) {
-			lock_guard<mutex> lock(core->coreMtx);
-			if(core->current && core->current->getName() == name) {
-				return core->current.get();
-			}
-		}
-
-		{
-			lock_guard<mutex> lock(mtx);
-			for(auto &proc : readyQueue) {
-				if(proc && proc->getName() == name) {
-					return proc.get();
-				}	
-			}
+	//a name nobody interned cannot belong to a process, the rest are integer compares
+	optional<ProcessInfo> describeProcess(const string& name) {
+		uint32_t id;
+		if(!interner.find(name, id)) return nullopt;
+		return describeMatch([id](Process& p) { return p.getNameId() == id; });
+	}
 
-			for(auto &proc : finished) {
-				if(proc && proc->getName() == name) {
-					return proc.get();
-				}	
-			}
+	optional<ProcessInfo> describeProcess(int pid) {
+		return describeMatch([pid](Process& p) { return p.getPid() == pid; });
+	}
 
-			for(auto &proc : sleepingQueue) {
-				if(proc && proc->getName() == name) {
-					return proc.get();
-				}
+	/*
+	 * copies the first process on a core or in any queue that matches
+	 *
+	 * the copy is taken under the lock that holds the process, once that is
+	 * released the process may finish, move or migrate to another node
+	 * */
+	template<typename Match>
+	optional<ProcessInfo> describeMatch(Match match) {
+		for(Core* core : liveCores()) {
+			ProfiledLock lock(core->coreMtx, siteCoreSearch);
+			if(core->current && match(*core->current)) {
+				return core->current->info();
 			}
 		}
 
-		return nullopt;
-	}
-
-	void enterProcessScreen(string name)
-	{
-		string rawInput;
-		vector<string> cmd;
-		bool screenDisplay = true;
-
-		auto rawProc = searchProcess(name);
-
-		if(!rawProc) {
-			cout << "Process <" << name << "> not found." << endl;
-			screenDisplay = false;
-		} else {
-			//clear screen
-			cout << "\033[2J\033[1;1H";
+		ProfiledLock lock(mtx, siteSearch);
+		for(auto &proc : readyQueue) {
+			if(proc && match(*proc)) {
+				return proc->info();
+			}	
 		}
 
-		Process *p = *rawProc;
-		while (screenDisplay)
-		{
-			cout << "root:\\> ";
-			getline(cin, rawInput);
-			cmd = tokenizeInput(rawInput);
+		for(auto &proc : finished) {
+			if(proc && match(*proc)) {
+				return proc->info();
+			}	
+		}
 
-			if (cmd[0] == "process-smi")
-			{
-				cout << endl;
-				cout << "Process name: " << p->getName() << endl;
-				cout << "ID: " << p->getPid() << endl;
-				cout << "Logs:" << endl << p->toStringLogs() << endl;
-				if(p->getInstructionPointer() != p->getInstructionCount()) {
-					cout << "Current instruction Line: " << p->getInstructionPointer() << endl;
-					cout << "Lines of code: " << p->getInstructionCount() << endl
-						<< endl;
-				} else {
-					cout << "Finished!" << endl
-						<< endl;
-				}
-			}
-			else if (cmd[0] == "exit")
-			{
-				cout << "Returning home..." << endl;
-				break;
-			}
-			else
-			{
-				cout << "Unknown command inside process screen." << endl;
+		for(auto &proc : sleepingQueue) {
+			if(proc && match(*proc)) {
+				return proc->info();
 			}
 		}
+
+		optional<ProcessInfo> waiting;
+		io.forEach([&](Process& p) {
+			if(!waiting && match(p)) waiting = p.info();
+		});
+		return waiting;
 	}
 
 };
@@ -0,0 +1,152 @@
+#include <iomanip>
+
+/*
+ * log-bucketed histogram in the style of HdrHistogram
+ *
+ * values below 16 get their own bucket, larger values are split into 16
+ * sub-buckets per power of two, so any reported percentile is within 6.25%
+ * of the recorded value
+ * */
+class LatencyHistogram {
+	static constexpr int SUB_BITS = 4;
+	static constexpr int SUB = 1 << SUB_BITS;
+	static constexpr int BUCKETS = 64 * SUB;
+
+	array<atomic<uint64_t>, BUCKETS> counts;
+	atomic<uint64_t> total;
+	atomic<uint64_t> sum;
+	atomic<uint64_t> maxValue;
+
+	static int bucketOf(uint64_t v) {
+		if(v < SUB) return v;
+		int e = 63 - __builtin_clzll(v);
+		int sub = (v >> (e - SUB_BITS)) & (SUB - 1);
+		return (e - SUB_BITS + 1) * SUB + sub;
+	}
+
+	//highest value that lands in bucket b
+	static uint64_t upperBound(int b) {
+		if(b < SUB) return b;
+		int e = b / SUB + SUB_BITS - 1;
+		uint64_t lower = uint64_t(SUB + b % SUB) << (e - SUB_BITS);
+		return lower + (uint64_t(1) << (e - SUB_BITS)) - 1;
+	}
+
+public:
+	LatencyHistogram() :
+		total(0),
+		sum(0),
+		maxValue(0)
+	{
+		for(auto &c : counts) c = 0;
+	}
+
+	void record(uint64_t v) {
+		counts[bucketOf(v)].fetch_add(1, memory_order_relaxed);
+		total.fetch_add(1, memory_order_relaxed);
+		sum.fetch_add(v, memory_order_relaxed);
+
+		uint64_t prev = maxValue.load(memory_order_relaxed);
+		while(v > prev && !maxValue.compare_exchange_weak(prev, v, memory_order_relaxed)) {}
+	}
+
+	/*
+	 * @param p - percentile between 0 and 100
+	 * @returns uint64_t - upper bound of the bucket holding the percentile
+	 * */
+	uint64_t percentile(double p) const {
+		uint64_t n = total.load(memory_order_relaxed);
+		if(n == 0) return 0;
+
+		uint64_t rank = max<uint64_t>(1, (uint64_t)(p / 100.0 * n + 0.5));
+		uint64_t seen = 0;
+		for(int b = 0; b < BUCKETS; b++) {
+			seen += counts[b].load(memory_order_relaxed);
+			if(seen >= rank)
+				return min(upperBound(b), getMax());
+		}
+		return getMax();
+	}
+
+	uint64_t getCount() const { return total.load(memory_order_relaxed); }
+	uint64_t getMax() const { return maxValue.load(memory_order_relaxed); }
+	uint64_t getSum() const { return sum.load(memory_order_relaxed); }
+
+	//non-empty buckets by index, what a checkpoint stores
+	vector<pair<uint64_t, uint64_t>> rawBuckets() const {
+		vector<pair<uint64_t, uint64_t>> out;
+		for(int b = 0; b < BUCKETS; b++) {
+			uint64_t c = counts[b].load(memory_order_relaxed);
+			if(c) out.push_back({(uint64_t)b, c});
+		}
+		return out;
+	}
+
+	/*
+	 * puts back a histogram saved with rawBuckets, getSum and getMax
+	 *
+	 * @returns bool - false if a bucket index is out of range
+	 * */
+	bool restore(const vector<pair<uint64_t, uint64_t>>& raw, uint64_t sum_, uint64_t max_) {
+		uint64_t n = 0;
+		for(auto &[b, c] : raw) {
+			if(b >= BUCKETS) return false;
+			counts[b].store(c, memory_order_relaxed);
+			n += c;
+		}
+		total.store(n, memory_order_relaxed);
+		sum.store(sum_, memory_order_relaxed);
+		maxValue.store(max_, memory_order_relaxed);
+		return true;
+	}
+
+	//bucket upper bounds and their counts, skipping empty buckets
+	vector<pair<uint64_t, uint64_t>> buckets() const {
+		vector<pair<uint64_t, uint64_t>> out;
+		for(int b = 0; b < BUCKETS; b++) {
+			uint64_t c = counts[b].load(memory_order_relaxed);
+			if(c) out.push_back({upperBound(b), c});
+		}
+		return out;
+	}
+};
+
+/*
+ * turnaround, waiting and response times of finished processes in microseconds
+ * */
+struct LatencyStats {
+	LatencyHistogram turnaround;
+	LatencyHistogram waiting;
+	LatencyHistogram response;
+
+	void record(Process& p) {
+		turnaround.record(p.getTurnaroundUs());
+		waiting.record(p.getWaitingUs());
+		response.record(p.getResponseUs());
+	}
+
+	/*
+	 * renders p50/p90/p99/max of every histogram in milliseconds
+	 *
+	 * @param label - printed in front of each row
+	 * */
+	string summary(const string& label) const {
+		stringstream ss;
+		ss << fixed << setprecision(1);
+		auto row = [&](const char* name, const LatencyHistogram& h) {
+			ss << label << "\t" << name << "\t" << h.getCount()
+				<< "\t" << h.percentile(50) / 1000.0
+				<< "\t" << h.percentile(90) / 1000.0
+				<< "\t" << h.percentile(99) / 1000.0
+				<< "\t" << h.getMax() / 1000.0 << "\n";
+		};
+		row("turnaround", turnaround);
+		row("waiting", waiting);
+		row("response", response);
+		return ss.str();
+	}
+
+	static string header() {
+		return "scope\tmetric\tcount\tp50ms\tp90ms\tp99ms\tmaxms\n";
+	}
+};
@@ -0,0 +1,171 @@
+/*
+ * top screen
+ *
+ * redraws a summary of the scheduler at a fixed rate from topSnapshot(),
+ * which copies no logs and no finished processes. sorting, filtering and
+ * paging run on the copy, and only rows that changed since the previous
+ * frame are rewritten, so an idle screen writes next to nothing.
+ *
+ * while it runs, input lines are read as keys:
+ *   s remaining|wait|pid   sort the process table
+ *   n / p                  next / previous page
+ *   f <text> / f           filter by name / clear the filter
+ *   q                      back to the prompt
+ * */
+class TopScreen {
+	static constexpr size_t MAX_CORE_ROWS = 16;
+
+	string sortKey = "remaining";
+	string filter;
+	size_t page = 0;
+	size_t pageSize = 10;
+	int refreshMs;
+
+	CounterTotals last;
+	vector<string> shown;	// rows currently on the terminal
+
+	static string pad(const string& text, size_t width) {
+		return text.size() >= width ? text.substr(0, width) : text + string(width - text.size(), ' ');
+	}
+
+	vector<string> render(TopSnapshot& snap) {
+		vector<string> rows;
+		stringstream ss;
+
+		CounterTotals d = snap.totals - last;
+		double secs = snap.totals.seconds(last);
+		last = snap.totals;
+
+		ss << fixed << setprecision(1);
+		ss << "top - cycle " << snap.cycle << "   instr/s " << (secs > 0 ? d.instructions / secs : 0)
+			<< "   util " << d.utilization() << "%   refresh " << refreshMs << "ms";
+		rows.push_back(ss.str());
+		ss.str("");
+
+		AdmissionStats& a = snap.admission;
+		ss << "ready " << a.ready << "   sleeping " << a.sleeping << "   finished " << snap.finished
+			<< "   spilled " << a.spillDepth << "   dropped " << a.dropped;
+		rows.push_back(ss.str());
+		ss.str("");
+		rows.push_back("");
+
+		//cores
+		size_t busy = 0;
+		for(auto &core : snap.cores) {
+			if(core.pid >= 0) busy++;
+		}
+		rows.push_back("cores " + to_string(snap.coreCount) + ", busy " + to_string(busy));
+		rows.push_back(pad("core", 6) + pad("pid", 8) + pad("process", 20) + "progress");
+		for(size_t i = 0; i < snap.cores.size() && i < MAX_CORE_ROWS; i++) {
+			TopCore& core = snap.cores[i];
+			string state = core.pid >= 0
+				? to_string(core.instrPointer) + " / " + to_string(core.instrCount)
+				: (core.parked ? "parked" : "idle");
+			rows.push_back(pad(to_string(core.id), 6)
+				+ pad(core.pid >= 0 ? to_string(core.pid) : "-", 8)
+				+ pad(core.pid >= 0 ? interner.lookup(core.nameId) : "", 20) + state);
+		}
+		if(snap.cores.size() > MAX_CORE_ROWS)
+			rows.push_back("... " + to_string(snap.cores.size() - MAX_CORE_ROWS) + " more cores");
+		rows.push_back("");
+
+		//processes, filtered and sorted on the copy
+		vector<TopProcess>& procs = snap.procs;
+		if(!filter.empty()) {
+			procs.erase(remove_if(procs.begin(), procs.end(), [this](const TopProcess& p) {
+				return interner.lookup(p.nameId).find(filter) == string::npos;
+			}), procs.end());
+		}
+		size_t pages = max<size_t>(1, (procs.size() + pageSize - 1) / pageSize);
+		page = min(page, pages - 1);
+		size_t end = min(procs.size(), (page + 1) * pageSize);
+
+		auto order = [this](const TopProcess& a, const TopProcess& b) {
+			if(sortKey == "wait") return a.waitUs > b.waitUs;
+			if(sortKey == "pid") return a.pid < b.pid;
+			return a.remaining > b.remaining;
+		};
+		partial_sort(procs.begin(), procs.begin() + end, procs.end(), order);
+
+		rows.push_back("processes " + to_string(procs.size()) + "   sort " + sortKey
+			+ "   filter " + (filter.empty() ? "-" : filter)
+			+ "   page " + to_string(page + 1) + "/" + to_string(pages));
+		rows.push_back(pad("pid", 8) + pad("process", 20) + pad("state", 10) + pad("remaining", 11) + "wait ms");
+		for(size_t i = page * pageSize; i < end; i++) {
+			TopProcess& p = procs[i];
+			rows.push_back(pad(to_string(p.pid), 8) + pad(interner.lookup(p.nameId), 20) + pad(p.state, 10)
+				+ pad(to_string(p.remaining), 11) + to_string(p.waitUs / 1000));
+		}
+		rows.push_back("");
+		rows.push_back("s remaining|wait|pid   n/p page   f <text> filter   q quit");
+		return rows;
+	}
+
+	//rewrites only the rows that differ from what is on the terminal
+	void draw(ostream& out, const vector<string>& rows) {
+		if(shown.empty())
+			out << "\033[2J";
+		for(size_t i = 0; i < max(rows.size(), shown.size()); i++) {
+			const string& row = i < rows.size() ? rows[i] : "";
+			if(i < shown.size() && shown[i] == row) continue;
+			out << "\033[" << i + 1 << ";1H" << row << "\033[K";
+		}
+		out << "\033[" << rows.size() + 1 << ";1H";
+		out.flush();
+		shown = rows;
+	}
+
+	//applies one input line, false to leave the screen
+	bool handleKey(const string& line) {
+		vector<string> key = tokenizeInput(line);
+		if(key.empty()) return true;
+		if(key[0] == "q" || key[0] == "exit") return false;
+		if(key[0] == "n") page++;
+		else if(key[0] == "p" && page > 0) page--;
+		else if(key[0] == "s" && key.size() >= 2 &&
+			(key[1] == "remaining" || key[1] == "wait" || key[1] == "pid")) {
+			sortKey = key[1];
+			page = 0;
+		}
+		else if(key[0] == "f") {
+			filter = key.size() >= 2 ? key[1] : "";
+			page = 0;
+		}
+		return true;
+	}
+
+public:
+	explicit TopScreen(int refreshMs_) :
+		refreshMs(refreshMs_)
+	{}
+
+	/*
+	 * runs until q, cancel or Ctrl-C
+	 *
+	 * @param scheduler - source of the snapshots
+	 * @param out - console stream of the command
+	 * */
+	void run(Scheduler& scheduler, ostream& out) {
+		last = scheduler.topSnapshot().totals;
+		auto nextFrame = SteadyClock::now();
+
+		while(out && !cancelRequested) {
+			auto now = SteadyClock::now();
+			if(now >= nextFrame) {
+				TopSnapshot snap = scheduler.topSnapshot();
+				draw(out, render(snap));
+				nextFrame = now + chrono::milliseconds(refreshMs);
+			}
+
+			string line;
+			auto wait = chrono::duration_cast<chrono::milliseconds>(nextFrame - SteadyClock::now());
+			if(commandQueue.popFor(line, max(wait, chrono::milliseconds(1)))) {
+				if(!handleKey(line)) break;
+				nextFrame = SteadyClock::now();	// show the key's effect right away
+			} else {
+				this_thread::sleep_until(nextFrame);
+			}
+		}
+		out << "\033[" << shown.size() + 1 << ";1H" << flush;
+	}
+};
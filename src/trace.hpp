@@ -0,0 +1,168 @@
+#include <fstream>
+
+/*
+ * timeline tracing of core occupancy
+ *
+ * cores push compact events into their own ring buffer, trace-dump turns them
+ * into chrome trace-event json that perfetto and chrome://tracing can load.
+ * while tracing is off every trace point costs a single atomic load.
+ * */
+enum TraceType : uint8_t {
+	TRACE_SLICE,
+	TRACE_SLEEP,
+	TRACE_IDLE,
+	TRACE_ARRIVE,
+	TRACE_REQUEUE,
+	TRACE_FINISH,
+	TRACE_IO
+};
+
+struct TraceEvent {
+	uint64_t ts;
+	int32_t pid;
+	uint8_t type;
+	char phase;	// 'B' begin, 'E' end, 'i' instant
+	uint16_t pad;
+};
+static_assert(sizeof(TraceEvent) == 16, "trace events must stay 16 bytes");
+
+atomic<bool> tracing(false);
+const SteadyClock::time_point traceEpoch = SteadyClock::now();
+
+/*
+ * single producer ring, the oldest events are overwritten once it is full
+ * */
+class TraceRing {
+public:
+	static constexpr size_t CAPACITY = 1 << 16;
+
+private:
+	unique_ptr<TraceEvent[]> events;
+	atomic<uint64_t> head;
+
+public:
+	TraceRing() :
+		events(new TraceEvent[CAPACITY]),
+		head(0)
+	{}
+
+	void push(TraceType type, char phase, int pid) {
+		uint64_t h = head.load(memory_order_relaxed);
+		TraceEvent& e = events[h & (CAPACITY - 1)];
+		e.ts = chrono::duration_cast<chrono::nanoseconds>(SteadyClock::now() - traceEpoch).count();
+		e.pid = pid;
+		e.type = type;
+		e.phase = phase;
+		head.store(h + 1, memory_order_release);
+	}
+
+	//copies the events that are still intact, oldest first
+	vector<TraceEvent> snapshot() const {
+		uint64_t end = head.load(memory_order_acquire);
+		uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+
+		vector<TraceEvent> out;
+		out.reserve(end - begin);
+		for(uint64_t i = begin; i < end; i++) {
+			out.push_back(events[i & (CAPACITY - 1)]);
+		}
+
+		//drop whatever the producer may have overwritten while copying
+		uint64_t after = head.load(memory_order_acquire);
+		uint64_t safe = after > CAPACITY ? after - CAPACITY : 0;
+		if(safe > begin)
+			out.erase(out.begin(), out.begin() + min<uint64_t>(safe - begin, out.size()));
+		return out;
+	}
+};
+
+//the ring is only read after the flag, setTracing allocates it before enabling
+inline void traceEvent(const unique_ptr<TraceRing>& ring, TraceType type, char phase, int pid = -1) {
+	if(tracing.load(memory_order_acquire) && ring)
+		ring->push(type, phase, pid);
+}
+
+string jsonEscape(const string& in) {
+	string out;
+	for(char ch : in) {
+		if(ch == '"' || ch == '\\') out += '\\';
+		if(static_cast<unsigned char>(ch) >= 0x20) out += ch;
+	}
+	return out;
+}
+
+/*
+ * writes the rings as chrome trace json
+ *
+ * begin/end pairs become complete ("X") events so the timeline stays valid
+ * even if the ring dropped the start of a slice
+ *
+ * @param path - output file
+ * @param rings - one ring per track, the last one is the scheduler track
+ * @param names - pid to process name
+ * @returns bool - false if the file could not be written
+ * */
+bool writeChromeTrace(const string& path, const vector<pair<string, vector<TraceEvent>>>& rings,
+	const unordered_map<int, string>& names)
+{
+	ofstream out(path, ios::trunc);
+	if(!out.is_open()) return false;
+
+	static const char* typeNames[] = {"slice", "sleep", "idle", "arrive", "requeue", "finish", "io"};
+	auto label = [&](const TraceEvent& e) -> string {
+		if(e.type == TRACE_SLICE) {
+			auto it = names.find(e.pid);
+			return it != names.end() ? jsonEscape(it->second) : "PID-" + to_string(e.pid);
+		}
+		return typeNames[e.type];
+	};
+	auto us = [](uint64_t ns) { return to_string(ns / 1000) + "." + to_string(ns % 1000 / 100); };
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	auto emit = [&](const string& json) {
+		if(!first) out << ",\n";
+		out << json;
+		first = false;
+	};
+
+	for(size_t tid = 0; tid < rings.size(); tid++) {
+		emit("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" + to_string(tid)
+			+ ",\"args\":{\"name\":\"" + rings[tid].first + "\"}}");
+
+		vector<const TraceEvent*> open;
+		uint64_t last = 0;
+		for(const TraceEvent& e : rings[tid].second) {
+			last = e.ts;
+			if(e.phase == 'B') {
+				open.push_back(&e);
+			} else if(e.phase == 'E') {
+				auto it = find_if(open.rbegin(), open.rend(), [&](const TraceEvent* b) {
+					return b->type == e.type;
+				});
+				if(it == open.rend()) continue;
+				const TraceEvent* b = *it;
+				open.erase(next(it).base());
+				emit("{\"name\":\"" + label(*b) + "\",\"cat\":\"" + typeNames[b->type]
+					+ "\",\"ph\":\"X\",\"pid\":0,\"tid\":" + to_string(tid)
+					+ ",\"ts\":" + us(b->ts) + ",\"dur\":" + us(e.ts - b->ts)
+					+ ",\"args\":{\"pid\":" + to_string(b->pid) + "}}");
+			} else {
+				emit("{\"name\":\"" + label(e) + "\",\"cat\":\"queue\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":"
+					+ to_string(tid) + ",\"ts\":" + us(e.ts)
+					+ ",\"args\":{\"pid\":" + to_string(e.pid) + "}}");
+			}
+		}
+
+		//slices still open when the dump was taken end at the last event
+		for(const TraceEvent* b : open) {
+			emit("{\"name\":\"" + label(*b) + "\",\"cat\":\"" + typeNames[b->type]
+				+ "\",\"ph\":\"X\",\"pid\":0,\"tid\":" + to_string(tid)
+				+ ",\"ts\":" + us(b->ts) + ",\"dur\":" + us(last - b->ts)
+				+ ",\"args\":{\"pid\":" + to_string(b->pid) + "}}");
+		}
+	}
+
+	out << "\n]}\n";
+	return out.good();
+}